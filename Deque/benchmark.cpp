@@ -0,0 +1,451 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "deque.hpp"
+#include "spsc_queue.hpp"
+#include "work_stealing_deque.hpp"
+
+// Compares Deque with std::deque on push/pop/iterate workloads, SpscQueue
+// with a mutex-guarded Deque on a two-thread handoff, and runs fork-join
+// task trees on WorkStealingDeque workers. Prints one JSON array of results
+// to stdout:
+//   ./benchmark [n_elements]
+
+std::atomic<size_t> allocations{0};
+
+// These are kept out of line: once they are inlined into each other's
+// callers, GCC flags the malloc/free pairing as mismatched.
+__attribute__((noinline)) void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+struct Payload {
+  Payload(size_t n = 0) : data{n} {}
+  size_t data[8];
+};
+
+size_t value_of(size_t n) { return n; }
+size_t value_of(const Payload& p) { return p.data[0]; }
+
+// The segmented algorithms for Deque, the std ones for std::deque.
+template <typename T>
+size_t sum_values(const Deque<T>& d) {
+  return accumulate(d.begin(), d.end(), size_t(0),
+                    [](size_t sum, const T& x) { return sum + value_of(x); });
+}
+
+template <typename T>
+size_t sum_values(const std::deque<T>& d) {
+  return std::accumulate(
+      d.begin(), d.end(), size_t(0),
+      [](size_t sum, const T& x) { return sum + value_of(x); });
+}
+
+template <typename T>
+void copy_out(const Deque<T>& d, T* out) {
+  copy(d.begin(), d.end(), out);
+}
+
+template <typename T>
+void copy_out(const std::deque<T>& d, T* out) {
+  std::copy(d.begin(), d.end(), out);
+}
+
+template <typename T>
+void append_all(Deque<T>& d, const std::vector<T>& src) {
+  d.append_range(src.data(), src.data() + src.size());
+}
+
+template <typename T>
+void append_all(std::deque<T>& d, const std::vector<T>& src) {
+  d.insert(d.end(), src.begin(), src.end());
+}
+
+bool first_record = true;
+volatile size_t sink = 0;
+
+template <typename Body>
+void run_case(const std::string& container, const std::string& type,
+              const std::string& op, size_t n, Body&& body) {
+  size_t allocs_before = allocations.load();
+  auto start = std::chrono::steady_clock::now();
+  body();
+  double elapsed = std::chrono::duration<double, std::nano>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  size_t allocs = allocations.load() - allocs_before;
+  std::cout << (first_record ? "[\n" : ",\n");
+  first_record = false;
+  std::cout << "  {\"container\": \"" << container << "\", \"type\": \""
+            << type << "\", \"op\": \"" << op << "\", \"n\": " << n
+            << ", \"ns_per_op\": " << elapsed / n
+            << ", \"ops_per_sec\": " << n * 1e9 / elapsed
+            << ", \"allocs_per_op\": " << static_cast<double>(allocs) / n
+            << "}";
+  std::cout.flush();
+}
+
+template <typename Container>
+void bench(const std::string& container, const std::string& type, size_t n) {
+  using T = typename Container::value_type;
+  {
+    Container d;
+    run_case(container, type, "push_back", n, [&] {
+      for (size_t i = 0; i < n; ++i) {
+        d.push_back(T(i));
+      }
+    });
+    run_case(container, type, "iterate", n, [&] {
+      size_t sum = 0;
+      for (auto it = d.begin(); it != d.end(); ++it) {
+        sum += value_of(*it);
+      }
+      sink = sink + sum;
+    });
+    run_case(container, type, "accumulate", n,
+             [&] { sink = sink + sum_values(d); });
+    std::vector<T> buffer(n);
+    run_case(container, type, "copy_out", n, [&] {
+      copy_out(d, buffer.data());
+      sink = sink + value_of(buffer[n / 2]);
+    });
+    run_case(container, type, "index", n, [&] {
+      size_t sum = 0;
+      for (size_t i = 0; i < n; ++i) {
+        sum += value_of(d[(i * 7919) % n]);
+      }
+      sink = sink + sum;
+    });
+    run_case(container, type, "pop_front", n, [&] {
+      for (size_t i = 0; i < n; ++i) {
+        d.pop_front();
+      }
+    });
+  }
+  {
+    Container d;
+    run_case(container, type, "push_front", n, [&] {
+      for (size_t i = 0; i < n; ++i) {
+        d.push_front(T(i));
+      }
+    });
+    run_case(container, type, "pop_back", n, [&] {
+      for (size_t i = 0; i < n; ++i) {
+        d.pop_back();
+      }
+    });
+  }
+  {
+    std::vector<T> src;
+    for (size_t i = 0; i < n; ++i) {
+      src.push_back(T(i));
+    }
+    Container d;
+    run_case(container, type, "append_range", n, [&] { append_all(d, src); });
+  }
+  {
+    // Bounded FIFO: the element count stays at 1024 while n elements pass
+    // through.
+    Container d;
+    for (size_t i = 0; i < 1024; ++i) {
+      d.push_back(T(i));
+    }
+    run_case(container, type, "fifo", n, [&] {
+      for (size_t i = 0; i < n; ++i) {
+        d.push_back(T(i));
+        d.pop_front();
+      }
+    });
+  }
+}
+
+const size_t handoff_batch = 64;
+
+// One producer thread passes n messages to the consumer, which runs on the
+// calling thread and yields whenever it finds the queue empty.
+template <typename Produce, typename Consume>
+void handoff(Produce&& produce, Consume&& consume) {
+  std::thread producer(produce);
+  consume();
+  producer.join();
+}
+
+void bench_handoff(size_t n) {
+  {
+    Deque<size_t> d;
+    std::mutex mutex;
+    run_case("Deque+mutex", "size_t", "handoff", n, [&] {
+      handoff(
+          [&] {
+            for (size_t i = 0; i < n; ++i) {
+              std::lock_guard<std::mutex> lock(mutex);
+              d.push_back(i);
+            }
+          },
+          [&] {
+            size_t sum = 0;
+            for (size_t received = 0; received < n;) {
+              std::unique_lock<std::mutex> lock(mutex);
+              if (d.size() == 0) {
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
+              }
+              sum += d[0];
+              d.pop_front();
+              ++received;
+            }
+            sink = sink + sum;
+          });
+    });
+  }
+  {
+    Deque<size_t> d;
+    std::mutex mutex;
+    run_case("Deque+mutex", "size_t", "handoff_batch", n, [&] {
+      handoff(
+          [&] {
+            size_t batch[handoff_batch];
+            for (size_t i = 0; i < n; i += handoff_batch) {
+              size_t count = std::min(handoff_batch, n - i);
+              for (size_t j = 0; j < count; ++j) {
+                batch[j] = i + j;
+              }
+              std::lock_guard<std::mutex> lock(mutex);
+              d.append_range(batch, batch + count);
+            }
+          },
+          [&] {
+            size_t sum = 0;
+            for (size_t received = 0; received < n;) {
+              std::unique_lock<std::mutex> lock(mutex);
+              size_t count = std::min(handoff_batch, d.size());
+              if (count == 0) {
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
+              }
+              sum += accumulate(d.begin(), d.begin() + count, size_t(0));
+              d.erase(d.begin(), d.begin() + count);
+              received += count;
+            }
+            sink = sink + sum;
+          });
+    });
+  }
+  {
+    SpscQueue<size_t> q;
+    run_case("SpscQueue", "size_t", "handoff", n, [&] {
+      handoff(
+          [&] {
+            for (size_t i = 0; i < n; ++i) {
+              q.push(i);
+            }
+          },
+          [&] {
+            size_t sum = 0;
+            size_t value = 0;
+            for (size_t received = 0; received < n;) {
+              if (!q.try_pop(value)) {
+                std::this_thread::yield();
+                continue;
+              }
+              sum += value;
+              ++received;
+            }
+            sink = sink + sum;
+          });
+    });
+  }
+  {
+    SpscQueue<size_t> q;
+    run_case("SpscQueue", "size_t", "handoff_batch", n, [&] {
+      handoff(
+          [&] {
+            size_t batch[handoff_batch];
+            for (size_t i = 0; i < n; i += handoff_batch) {
+              size_t count = std::min(handoff_batch, n - i);
+              for (size_t j = 0; j < count; ++j) {
+                batch[j] = i + j;
+              }
+              q.push_n(batch, count);
+            }
+          },
+          [&] {
+            size_t sum = 0;
+            size_t batch[handoff_batch];
+            for (size_t received = 0; received < n;) {
+              size_t count = q.pop_n(batch, handoff_batch);
+              if (count == 0) {
+                std::this_thread::yield();
+                continue;
+              }
+              for (size_t j = 0; j < count; ++j) {
+                sum += batch[j];
+              }
+              received += count;
+            }
+            sink = sink + sum;
+          });
+    });
+  }
+}
+
+// Runs the task tree rooted at root on n_threads workers, each owning a
+// WorkStealingDeque. run(task, spawn) executes one task and may spawn
+// children; idle workers steal from the others round-robin. Returns once
+// every spawned task has run.
+template <typename Task, typename Run>
+void fork_join(size_t n_threads, Task root, Run run) {
+  std::vector<std::unique_ptr<WorkStealingDeque<Task>>> deques;
+  for (size_t i = 0; i < n_threads; ++i) {
+    deques.emplace_back(new WorkStealingDeque<Task>());
+  }
+  std::atomic<size_t> pending{1};
+  deques[0]->push(root);
+  auto worker = [&](size_t id) {
+    WorkStealingDeque<Task>& own = *deques[id];
+    auto spawn = [&](Task task) {
+      pending.fetch_add(1, std::memory_order_relaxed);
+      own.push(task);
+    };
+    size_t victim = id;
+    while (pending.load(std::memory_order_acquire) > 0) {
+      std::optional<Task> task = own.pop();
+      for (size_t i = 1; !task && i < n_threads; ++i) {
+        victim = (victim + 1) % n_threads;
+        if (victim != id) {
+          task = deques[victim]->steal();
+        }
+      }
+      if (!task) {
+        std::this_thread::yield();
+        continue;
+      }
+      run(*task, spawn);
+      pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < n_threads; ++i) {
+    threads.emplace_back(worker, i);
+  }
+  worker(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+const unsigned fib_cutoff = 16;
+const uint32_t sum_leaf = 4096;
+
+size_t fib(unsigned n) { return (n < 2) ? n : fib(n - 1) + fib(n - 2); }
+
+size_t fib_tasks(unsigned n) {
+  return (n < fib_cutoff) ? 1 : 1 + fib_tasks(n - 1) + fib_tasks(n - 2);
+}
+
+struct SumRange {
+  uint32_t begin;
+  uint32_t end;
+};
+
+size_t sum_tasks(uint32_t size) {
+  return (size <= sum_leaf) ? 1 : 1 + sum_tasks(size / 2) +
+                                      sum_tasks(size - size / 2);
+}
+
+// A run that lost or repeated a task would time the wrong work, so the
+// results are checked and a mismatch stops the benchmark.
+void check_result(const std::string& name, size_t result, size_t expected) {
+  if (result != expected) {
+    std::cerr << name << ": got " << result << ", expected " << expected
+              << '\n';
+    std::exit(1);
+  }
+}
+
+// Parallel Fibonacci and parallel array sum at 1, 2, 4, ... workers up to
+// the hardware thread count; ns_per_op is per task.
+void bench_fork_join(size_t n) {
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  unsigned fib_n = 32;
+  size_t fib_expected = fib(fib_n);
+  std::vector<uint32_t> values(n);
+  for (size_t i = 0; i < n; ++i) {
+    values[i] = static_cast<uint32_t>(i);
+  }
+  size_t sum_expected = (n == 0) ? 0 : n * (n - 1) / 2;
+  for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+    std::string container =
+        "WorkStealingDeque x" + std::to_string(n_threads);
+    run_case(container, "task", "fib", fib_tasks(fib_n), [&] {
+      std::atomic<size_t> result{0};
+      fork_join(n_threads, fib_n, [&](unsigned k, auto& spawn) {
+        if (k < fib_cutoff) {
+          result.fetch_add(fib(k), std::memory_order_relaxed);
+        } else {
+          spawn(k - 1);
+          spawn(k - 2);
+        }
+      });
+      check_result(container + " fib", result.load(), fib_expected);
+      sink = sink + result.load();
+    });
+    uint32_t size = static_cast<uint32_t>(n);
+    run_case(container, "task", "sum", sum_tasks(size), [&] {
+      std::atomic<size_t> result{0};
+      fork_join(n_threads, SumRange{0, size},
+                [&](SumRange range, auto& spawn) {
+                  if (range.end - range.begin <= sum_leaf) {
+                    size_t sum = 0;
+                    for (uint32_t i = range.begin; i < range.end; ++i) {
+                      sum += values[i];
+                    }
+                    result.fetch_add(sum, std::memory_order_relaxed);
+                  } else {
+                    uint32_t middle =
+                        range.begin + (range.end - range.begin) / 2;
+                    spawn(SumRange{range.begin, middle});
+                    spawn(SumRange{middle, range.end});
+                  }
+                });
+      check_result(container + " sum", result.load(), sum_expected);
+      sink = sink + result.load();
+    });
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  bench<Deque<size_t>>("Deque", "size_t", n);
+  bench<std::deque<size_t>>("std::deque", "size_t", n);
+  bench<Deque<Payload>>("Deque", "Payload64", n);
+  bench<std::deque<Payload>>("std::deque", "Payload64", n);
+  bench_handoff(n);
+  bench_fork_join(n);
+  std::cout << "\n]\n";
+}
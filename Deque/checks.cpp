@@ -0,0 +1,426 @@
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "deque.hpp"
+#include "spsc_queue.hpp"
+#include "work_stealing_deque.hpp"
+
+// Differential check against std::deque: a random sequence of operations is
+// applied to both containers and their contents compared as it goes. The
+// concurrent queues are checked from real threads. Build with -pthread and
+// without NDEBUG.
+
+// Small baskets for strings, so that short runs already cross many of them.
+template <>
+struct DequeBasketSize<std::string> {
+  static constexpr size_t value = 8;
+};
+
+// Counts live objects, to catch elements that are leaked or destroyed twice.
+struct Counted {
+  static long live;
+
+  Counted(long value = 0) : value(value) { ++live; }
+  Counted(const Counted& other) : value(other.value) { ++live; }
+  Counted& operator=(const Counted& other) = default;
+  ~Counted() { --live; }
+
+  bool operator==(const Counted& other) const { return value == other.value; }
+
+  long value;
+};
+
+long Counted::live = 0;
+
+// Throws from the copy constructor once `copies_left` copies have been made.
+struct Fragile {
+  static long copies_left;
+
+  Fragile(long value = 0) : value(value) {}
+  Fragile(const Fragile& other) : value(other.value) {
+    if (copies_left-- == 0) {
+      throw std::runtime_error("Fragile: copy failed");
+    }
+  }
+  Fragile& operator=(const Fragile& other) = default;
+
+  long value;
+};
+
+long Fragile::copies_left = -1;
+
+const size_t n_operations = 13;
+
+template <typename T>
+void check_equal(const Deque<T>& d, const std::deque<T>& ref) {
+  assert(d.size() == ref.size());
+  size_t i = 0;
+  for (auto it = d.begin(); it != d.end(); ++it, ++i) {
+    assert(*it == ref[i]);
+  }
+}
+
+template <typename T, typename Make>
+void run(const char* name, Make make, size_t n_steps) {
+  std::mt19937_64 rng(42);
+  Deque<T> d;
+  std::deque<T> ref;
+  auto random_values = [&](size_t n_values) {
+    std::vector<T> values;
+    for (size_t i = 0; i < n_values; ++i) {
+      values.push_back(make(rng()));
+    }
+    return values;
+  };
+  for (size_t step = 0; step < n_steps; ++step) {
+    size_t pos = rng() % (ref.size() + 1);
+    size_t n_values = rng() % ((rng() % 4 == 0) ? 100 : 6);
+    switch (rng() % n_operations) {
+      case 0: {
+        T value = make(rng());
+        d.push_back(value);
+        ref.push_back(value);
+        break;
+      }
+      case 1: {
+        T value = make(rng());
+        d.push_front(value);
+        ref.push_front(value);
+        break;
+      }
+      case 2:
+        if (!ref.empty()) {
+          d.pop_back();
+          ref.pop_back();
+        }
+        if (!ref.empty()) {
+          d.pop_front();
+          ref.pop_front();
+        }
+        break;
+      case 3: {
+        T value = make(rng());
+        d.insert(d.cbegin() + pos, value);
+        ref.insert(ref.begin() + pos, value);
+        break;
+      }
+      case 4:
+        if (pos < ref.size()) {
+          d.erase(d.begin() + pos);
+          ref.erase(ref.begin() + pos);
+        }
+        break;
+      case 5: {
+        Deque<T> copy(d);
+        check_equal(copy, ref);
+        Deque<T> moved(std::move(copy));
+        d = moved;
+        if (rng() % 8 == 0) {
+          d.assign(ref.begin(), ref.end());
+        }
+        break;
+      }
+      case 6: {
+        T value = make(rng());
+        auto it = d.emplace(d.cbegin() + pos, value);
+        assert(*it == value);
+        ref.insert(ref.begin() + pos, value);
+        break;
+      }
+      case 7: {
+        // std::deque in libstdc++ 12 misplaces an element when an empty
+        // range is inserted in the middle, so only non-empty ranges.
+        std::vector<T> values = random_values(n_values + 1);
+        auto it = d.insert(d.cbegin() + pos, values.begin(), values.end());
+        assert(it - d.begin() == static_cast<std::ptrdiff_t>(pos));
+        ref.insert(ref.begin() + pos, values.begin(), values.end());
+        break;
+      }
+      case 8:
+        if (pos < ref.size()) {
+          size_t last = pos + std::min(n_values, ref.size() - pos);
+          auto it = d.erase(d.cbegin() + pos, d.cbegin() + last);
+          assert(it - d.begin() == static_cast<std::ptrdiff_t>(pos));
+          ref.erase(ref.begin() + pos, ref.begin() + last);
+        }
+        break;
+      case 9: {
+        std::vector<T> values = random_values(n_values);
+        std::list<T> source(values.begin(), values.end());
+        d.append_range(source.begin(), source.end());
+        ref.insert(ref.end(), values.begin(), values.end());
+        break;
+      }
+      case 10: {
+        std::vector<T> values = random_values(n_values);
+        d.prepend_range(values.begin(), values.end());
+        ref.insert(ref.begin(), values.begin(), values.end());
+        break;
+      }
+      case 11: {
+        Deque<T> other(ref.begin(), ref.begin() + pos);
+        d.append_range(other.cbegin(), other.cend());
+        d.prepend_range(other.begin(), other.end());
+        std::deque<T> copy(ref.begin(), ref.begin() + pos);
+        ref.insert(ref.end(), copy.begin(), copy.end());
+        ref.insert(ref.begin(), copy.begin(), copy.end());
+        break;
+      }
+      case 12:
+        if (ref.size() > 2000) {
+          size_t size = rng() % 200;
+          d.resize(size);
+          ref.resize(size);
+        }
+        d.shrink_to_fit();
+        assert(d.memory_usage() > 0 || d.size() == 0);
+        break;
+    }
+    assert(d.size() == ref.size());
+    if (step % 64 == 0) {
+      check_equal(d, ref);
+    }
+  }
+  check_equal(d, ref);
+  d.shrink_to_fit();
+  check_equal(d, ref);
+  std::cout << name << '\n';
+}
+
+int main() {
+  run<int>("int", [](uint64_t r) { return static_cast<int>(r % 1000); },
+           40000);
+  run<std::string>("std::string",
+                   [](uint64_t r) { return std::string(r % 40, 'a' + r % 26); },
+                   20000);
+  run<Counted>("Counted",
+               [](uint64_t r) { return Counted(static_cast<long>(r % 1000)); },
+               20000);
+  assert(Counted::live == 0);
+  {
+    Deque<Counted> d;
+    for (int round = 0; round < 4; ++round) {
+      for (long i = 0; i < 1000; ++i) {
+        d.push_back(Counted(i));
+        d.push_front(Counted(-i));
+      }
+      assert(d.size() == 2000 && d[0].value == -999 && d[1999].value == 999);
+      while (d.size() > 0) {
+        d.pop_back();
+      }
+    }
+    assert(Counted::live == 0);
+    std::cout << "empty and refill" << '\n';
+  }
+  {
+    Deque<int> d;
+    for (int i = 0; i < 64; ++i) {
+      d.push_back(i);
+    }
+    for (int i = 64; i < 200000; ++i) {
+      d.push_back(i);
+      d.pop_front();
+      assert(d.size() == 64 && d[0] == i - 63 && d[63] == i);
+    }
+    std::cout << "sliding queue" << '\n';
+  }
+  {
+    Deque<int> d;
+    for (int i = 0; i < 1000; ++i) {
+      d.push_front(999 - i);
+    }
+    std::vector<int> out(1000);
+    copy(d.cbegin(), d.cend(), out.data());
+    for (int i = 0; i < 1000; ++i) {
+      assert(out[i] == i);
+    }
+    assert(accumulate(d.cbegin(), d.cend(), 0L) == 499500);
+    fill(d.begin() + 100, d.begin() + 900, 7);
+    assert(find(d.begin(), d.end(), 7) - d.begin() == 7);
+    assert(find(d.cbegin() + 8, d.cend(), 7) - d.cbegin() == 100);
+    assert(find(d.begin(), d.end(), -1) == d.end());
+    copy(out.data(), out.data() + out.size(), d.begin());
+    assert(d[500] == 500);
+    std::cout << "segmented algorithms" << '\n';
+  }
+  {
+    Deque<long> d(100, 1);
+    fill(d.begin() + 10, d.end(), 0);
+    assert(find(d.begin(), d.end(), 0) - d.begin() == 10);
+    assert(accumulate(d.cbegin(), d.cend(), 0L) == 10);
+    std::cout << "mixed-type algorithms" << '\n';
+  }
+  {
+    Deque<Fragile> d(10, Fragile(1));
+    Deque<Fragile> other(300, Fragile(2));
+    Fragile::copies_left = 150;
+    bool thrown = false;
+    try {
+      d.append_range(other.begin(), other.end());
+    } catch (const std::runtime_error&) {
+      thrown = true;
+    }
+    Fragile::copies_left = -1;
+    assert(thrown && d.size() == 10);
+    for (size_t i = 0; i < d.size(); ++i) {
+      assert(d[i].value == 1);
+    }
+    std::cout << "strong append" << '\n';
+  }
+  {
+    Deque<Fragile> d(10, Fragile(1));
+    std::vector<Fragile> values(300, Fragile(2));
+    Fragile::copies_left = 150;
+    bool thrown = false;
+    try {
+      d.assign(values.begin(), values.end());
+    } catch (const std::runtime_error&) {
+      thrown = true;
+    }
+    Fragile::copies_left = -1;
+    assert(thrown && d.size() == 10);
+    for (size_t i = 0; i < d.size(); ++i) {
+      assert(d[i].value == 1);
+    }
+    Deque<std::string> s;
+    for (int i = 0; i < 100; ++i) {
+      s.push_back(std::to_string(i));
+    }
+    s.assign(s.begin() + 10, s.begin() + 60);
+    assert(s.size() == 50 && s[0] == "10" && s[49] == "59");
+    std::cout << "strong assign" << '\n';
+  }
+  {
+    Deque<int> d;
+    for (int i = 0; i < 100000; ++i) {
+      d.push_back(i);
+    }
+    while (d.size() > 10) {
+      d.pop_front();
+    }
+    size_t before = d.memory_usage();
+    d.shrink_to_fit();
+    assert(d.memory_usage() < before);
+    assert(d.allocated_baskets() <= 2 && d.map_size() <= 2);
+    assert(d[0] == 99990 && d[9] == 99999);
+    while (d.size() > 0) {
+      d.pop_back();
+    }
+    d.shrink_to_fit();
+    assert(d.memory_usage() == 0);
+    d.push_back(1);
+    assert(d.size() == 1 && d[0] == 1);
+    std::cout << "shrink to fit" << '\n';
+  }
+  {
+    // Strings use 8-element baskets, so the pushes and pops below cross a
+    // basket boundary every few elements.
+    const int n_items = 100000;
+    SpscQueue<std::string> queue;
+    std::thread producer([&queue] {
+      std::vector<std::string> batch;
+      for (int next = 0; next < n_items;) {
+        if (next % 3 == 0) {
+          batch.clear();
+          for (int i = 0; i < 13 && next + i < n_items; ++i) {
+            batch.push_back(std::to_string(next + i));
+          }
+          queue.push_n(batch.data(), batch.size());
+          next += static_cast<int>(batch.size());
+        } else if (next % 3 == 1) {
+          queue.push(std::to_string(next++));
+        } else {
+          queue.emplace(std::to_string(next++));
+        }
+      }
+    });
+    int expected = 0;
+    std::string buffer[11];
+    std::string value;
+    while (expected < n_items) {
+      size_t n_popped = 0;
+      if (expected % 2 == 0) {
+        n_popped = queue.pop_n(buffer, 11);
+        for (size_t i = 0; i < n_popped; ++i) {
+          assert(buffer[i] == std::to_string(expected++));
+        }
+      } else if (queue.try_pop(value)) {
+        assert(value == std::to_string(expected++));
+        n_popped = 1;
+      }
+      if (n_popped == 0) {
+        std::this_thread::yield();
+      }
+    }
+    producer.join();
+    assert(expected == n_items && !queue.try_pop(value));
+    {
+      SpscQueue<Counted> left_over;
+      for (long i = 0; i < 1000; ++i) {
+        left_over.push(Counted(i));
+      }
+      Counted first;
+      assert(left_over.try_pop(first) && first.value == 0);
+    }
+    assert(Counted::live == 0);
+    std::cout << "spsc queue" << '\n';
+  }
+  {
+    // Capacity 2, so the owner grows the array while thieves read it.
+    const long n_items = 200000;
+    const int n_thieves = 3;
+    WorkStealingDeque<long> deque(2);
+    std::vector<std::atomic<int>> taken(n_items + 1);
+    std::atomic<long> n_taken{0};
+    std::atomic<long> sum{0};
+    std::atomic<bool> done{false};
+    auto take = [&](long item) {
+      assert(item >= 1 && item <= n_items);
+      taken[item].fetch_add(1, std::memory_order_relaxed);
+      n_taken.fetch_add(1, std::memory_order_relaxed);
+      sum.fetch_add(item, std::memory_order_relaxed);
+    };
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < n_thieves; ++i) {
+      thieves.emplace_back([&] {
+        while (!done.load(std::memory_order_acquire) || !deque.empty()) {
+          if (std::optional<long> item = deque.steal()) {
+            take(*item);
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (long item = 1; item <= n_items; ++item) {
+      deque.push(item);
+      if (item % 3 == 0) {
+        if (std::optional<long> popped = deque.pop()) {
+          take(*popped);
+        }
+      }
+    }
+    while (std::optional<long> popped = deque.pop()) {
+      take(*popped);
+    }
+    done.store(true, std::memory_order_release);
+    for (std::thread& thief : thieves) {
+      thief.join();
+    }
+    assert(n_taken.load() == n_items);
+    assert(sum.load() == n_items * (n_items + 1) / 2);
+    for (long item = 1; item <= n_items; ++item) {
+      assert(taken[item].load() == 1);
+    }
+    std::cout << "work-stealing deque" << '\n';
+  }
+}
+
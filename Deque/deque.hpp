@@ -1,14 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 //=========================================================================================
 //                                    DECLARATION
 //=========================================================================================
 
+constexpr size_t deque_basket_bytes = 512;
+constexpr size_t deque_min_basket_size = 4;
+
+constexpr size_t floor_power_of_two(size_t n) {
+  size_t power = 1;
+  while (power <= n / 2) {
+    power *= 2;
+  }
+  return power;
+}
+
+constexpr size_t power_of_two_log(size_t n) {
+  size_t log = 0;
+  while ((size_t(1) << log) < n) {
+    ++log;
+  }
+  return log;
+}
+
+// Elements per basket: the largest power of two that fits in
+// deque_basket_bytes, but at least deque_min_basket_size. Specialize for a
+// type to override; the value must stay a power of two.
+template <typename T>
+struct DequeBasketSize {
+  static constexpr size_t value =
+      (sizeof(T) * deque_min_basket_size >= deque_basket_bytes)
+          ? deque_min_basket_size
+          : floor_power_of_two(deque_basket_bytes / sizeof(T));
+};
+
 template <typename T>
 class Deque;
 
 template <typename T, bool IsConst>
 class BaseDequeIterator {
+ private:
+  template <typename, bool>
+  friend class BaseDequeIterator;
+
  public:
   using value_type = T;
   using iterator_category = std::random_access_iterator_tag;
@@ -21,6 +66,7 @@ class BaseDequeIterator {
                     const Deque<T>* deque);
 
   BaseDequeIterator(const BaseDequeIterator<T, false>& it);
+  BaseDequeIterator& operator=(const BaseDequeIterator& it) = default;
   ~BaseDequeIterator() = default;
 
   BaseDequeIterator& operator++();
@@ -44,11 +90,24 @@ class BaseDequeIterator {
   friend std::ptrdiff_t operator-(BaseDequeIterator<U, IsConst1> it1,
                                   BaseDequeIterator<U, IsConst2> it2);
 
+  template <typename U, bool IsConst1, typename Func>
+  friend void for_each_segment(BaseDequeIterator<U, IsConst1> first,
+                               BaseDequeIterator<U, IsConst1> last, Func func);
+
+  template <typename U, bool IsConst1, typename Func>
+  friend void for_each_segment_while(BaseDequeIterator<U, IsConst1> first,
+                                     BaseDequeIterator<U, IsConst1> last,
+                                     Func func);
+
   reference operator*() const;
   pointer operator->() const;
 
  private:
+  pointer basket(size_type pos_out_basket) const;
+
   static const size_type basket_size_ = Deque<T>::basket_size_;
+  static const size_type basket_shift_ = Deque<T>::basket_shift_;
+  static const size_type basket_mask_ = Deque<T>::basket_mask_;
 
   size_type pos_out_basket_;
   size_type pos_in_basket_;
@@ -98,6 +157,46 @@ template <typename T, bool IsConst1, bool IsConst2>
 bool operator!=(const BaseDequeIterator<T, IsConst1>& it1,
                 const BaseDequeIterator<T, IsConst1>& it2);
 
+// Segmented algorithms: each walks the range one basket at a time and runs
+// a plain pointer loop inside the basket.
+template <typename T, bool IsConst, typename Func>
+void for_each_segment(BaseDequeIterator<T, IsConst> first,
+                      BaseDequeIterator<T, IsConst> last, Func func);
+
+template <typename T, bool IsConst, typename Func>
+void for_each_segment_while(BaseDequeIterator<T, IsConst> first,
+                            BaseDequeIterator<T, IsConst> last, Func func);
+
+template <typename T, bool IsConst, typename OutputIt>
+OutputIt copy(BaseDequeIterator<T, IsConst> first,
+              BaseDequeIterator<T, IsConst> last, OutputIt out);
+
+template <typename T>
+BaseDequeIterator<T, false> copy(const T* first, const T* last,
+                                 BaseDequeIterator<T, false> out);
+
+template <typename T, bool IsConst>
+BaseDequeIterator<T, false> copy(BaseDequeIterator<T, IsConst> first,
+                                 BaseDequeIterator<T, IsConst> last,
+                                 BaseDequeIterator<T, false> out);
+
+template <typename T, typename U>
+void fill(BaseDequeIterator<T, false> first, BaseDequeIterator<T, false> last,
+          const U& value);
+
+template <typename T, bool IsConst, typename U>
+BaseDequeIterator<T, IsConst> find(BaseDequeIterator<T, IsConst> first,
+                                   BaseDequeIterator<T, IsConst> last,
+                                   const U& value);
+
+template <typename T, bool IsConst, typename Acc>
+Acc accumulate(BaseDequeIterator<T, IsConst> first,
+               BaseDequeIterator<T, IsConst> last, Acc init);
+
+template <typename T, bool IsConst, typename Acc, typename BinaryOp>
+Acc accumulate(BaseDequeIterator<T, IsConst> first,
+               BaseDequeIterator<T, IsConst> last, Acc init, BinaryOp op);
+
 template <typename T>
 class Deque {
  private:
@@ -119,14 +218,44 @@ class Deque {
 
   Deque();
   Deque(const Deque<T>& other);
+  Deque(Deque<T>&& other) noexcept;
   explicit Deque(size_type size);
   explicit Deque(size_type size, const_reference value);
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  Deque(InputIt first, InputIt last);
+  Deque(std::initializer_list<T> list);
   Deque& operator=(const Deque<T>& other);
+  Deque& operator=(Deque<T>&& other) noexcept;
+
+  void swap(Deque<T>& other) noexcept;
 
   ~Deque();
 
   size_type size() const;
 
+  void resize(size_type size);
+  void resize(size_type size, const_reference value);
+  void reserve_back(size_type n_elements);
+  void reserve_front(size_type n_elements);
+  void shrink_to_fit();
+
+  // Memory held: baskets allocated (in the map or kept as spares), slots in
+  // the map, and the bytes of both together.
+  size_type allocated_baskets() const;
+  size_type map_size() const;
+  size_type memory_usage() const;
+
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  void assign(InputIt first, InputIt last);
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  void append_range(InputIt first, InputIt last);
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  void prepend_range(InputIt first, InputIt last);
+
   reference operator[](size_type pos);
   const_reference operator[](size_type pos) const;
 
@@ -134,10 +263,19 @@ class Deque {
   const_reference at(size_type pos) const;
 
   void push_front(const_reference value);
+  void push_front(value_type&& value);
   void pop_front();
   void push_back(const_reference value);
+  void push_back(value_type&& value);
   void pop_back();
 
+  template <typename... Args>
+  reference emplace_front(Args&&... args);
+  template <typename... Args>
+  reference emplace_back(Args&&... args);
+  template <typename... Args>
+  iterator emplace(const_iterator it, Args&&... args);
+
   iterator begin();
   const_iterator begin() const;
   const_iterator cbegin() const;
@@ -154,23 +292,56 @@ class Deque {
 
   void insert(iterator it, const_reference value);
   void insert(const_iterator it, const_reference value);
+  void insert(iterator it, value_type&& value);
+  void insert(const_iterator it, value_type&& value);
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  iterator insert(const_iterator it, InputIt first, InputIt last);
 
   void erase(const iterator& it);
   void erase(const_iterator it);
+  iterator erase(const_iterator first, const_iterator last);
 
  private:
   std::pair<size_type, size_type> calc_indexes(size_type pos) const;
   void check_range(size_type pos) const;
   void destroy_n_elements(size_type n_elements);
-  void create_data();
-
-  static const size_type basket_size_ = 3;
+  void leave_empty();
+  void make_room(size_type front_elements, size_type back_elements);
+  template <typename Construct>
+  void construct_back(size_type n_elements, Construct construct);
+  pointer acquire_basket();
+  void free_basket(pointer basket);
+  void ensure_basket(size_type pos_out_basket);
+  void release_basket(size_type pos_out_basket);
+
+  static const size_type basket_size_ = DequeBasketSize<T>::value;
+  static const size_type basket_shift_ = power_of_two_log(basket_size_);
+  static const size_type basket_mask_ = basket_size_ - 1;
+
+  static_assert((basket_size_ & basket_mask_) == 0,
+                "DequeBasketSize must be a power of two");
+
+  // Ranges of T in contiguous memory, which bulk loads copy with memcpy.
+  template <typename It>
+  static constexpr bool is_memcpy_source_ =
+      std::is_trivially_copyable<T>::value && std::is_pointer<It>::value &&
+      std::is_same<typename std::remove_cv<
+                       typename std::remove_pointer<It>::type>::type,
+                   T>::value;
+
+  // Emptied baskets kept for reuse, so a queue moving through the map does
+  // not allocate once it reaches a steady state.
+  static const size_type max_spare_baskets_ = 2;
 
   size_type n_baskets_;
   size_type first_pos_out_basket_;
   size_type first_pos_in_basket_;
-  pointer* data_;
+  pointer* data_ = nullptr;
   size_type size_;
+  pointer spare_baskets_[max_spare_baskets_];
+  size_type n_spare_baskets_ = 0;
+  size_type n_allocated_baskets_ = 0;
 };
 
 //=========================================================================================
@@ -196,8 +367,8 @@ inline BaseDequeIterator<T, IsConst>::BaseDequeIterator(
 template <typename T, bool IsConst>
 BaseDequeIterator<T, IsConst>& BaseDequeIterator<T, IsConst>::operator++() {
   ++pos_in_basket_;
-  pos_out_basket_ += pos_in_basket_ / basket_size_;
-  pos_in_basket_ %= basket_size_;
+  pos_out_basket_ += pos_in_basket_ >> basket_shift_;
+  pos_in_basket_ &= basket_mask_;
   return *this;
 }
 
@@ -212,8 +383,7 @@ template <typename T, bool IsConst>
 BaseDequeIterator<T, IsConst>& BaseDequeIterator<T, IsConst>::operator--() {
   pos_out_basket_ =
       (pos_in_basket_ == 0) ? pos_out_basket_ - 1 : pos_out_basket_;
-  pos_in_basket_ =
-      (pos_in_basket_ == 0) ? basket_size_ - 1 : pos_in_basket_ - 1;
+  pos_in_basket_ = (pos_in_basket_ - 1) & basket_mask_;
   return *this;
 }
 
@@ -236,22 +406,28 @@ BaseDequeIterator<T, IsConst>::operator->() const {
   return &deque_->data_[pos_out_basket_][pos_in_basket_];
 }
 
+template <typename T, bool IsConst>
+inline typename BaseDequeIterator<T, IsConst>::pointer
+BaseDequeIterator<T, IsConst>::basket(size_type pos_out_basket) const {
+  return deque_->data_[pos_out_basket];
+}
+
 template <typename T, bool IsConst>
 BaseDequeIterator<T, IsConst>& BaseDequeIterator<T, IsConst>::operator+=(
     difference_type diff) {
-  size_type cur_pos = pos_out_basket_ * basket_size_ + pos_in_basket_;
+  size_type cur_pos = (pos_out_basket_ << basket_shift_) + pos_in_basket_;
   cur_pos += diff;
-  pos_out_basket_ = cur_pos / basket_size_;
-  pos_in_basket_ = cur_pos % basket_size_;
+  pos_out_basket_ = cur_pos >> basket_shift_;
+  pos_in_basket_ = cur_pos & basket_mask_;
   return *this;
 }
 template <typename T, bool IsConst>
 BaseDequeIterator<T, IsConst>& BaseDequeIterator<T, IsConst>::operator-=(
     difference_type diff) {
-  size_type cur_pos = pos_out_basket_ * basket_size_ + pos_in_basket_;
+  size_type cur_pos = (pos_out_basket_ << basket_shift_) + pos_in_basket_;
   cur_pos -= diff;
-  pos_out_basket_ = cur_pos / basket_size_;
-  pos_in_basket_ = cur_pos % basket_size_;
+  pos_out_basket_ = cur_pos >> basket_shift_;
+  pos_in_basket_ = cur_pos & basket_mask_;
   return *this;
 }
 
@@ -287,15 +463,15 @@ BaseDequeIterator<T, IsConst> operator-(
 template <typename T, bool IsConst1, bool IsConst2>
 std::ptrdiff_t operator-(BaseDequeIterator<T, IsConst1> it1,
                          BaseDequeIterator<T, IsConst2> it2) {
-  return (it1.pos_out_basket_ * it1.basket_size_ + it1.pos_in_basket_) -
-         (it2.pos_out_basket_ * it2.basket_size_ + it2.pos_in_basket_);
+  return ((it1.pos_out_basket_ << it1.basket_shift_) + it1.pos_in_basket_) -
+         ((it2.pos_out_basket_ << it2.basket_shift_) + it2.pos_in_basket_);
 }
 
 template <typename T, bool IsConst1, bool IsConst2>
 inline bool operator<(const BaseDequeIterator<T, IsConst1>& it1,
                       const BaseDequeIterator<T, IsConst2>& it2) {
-  return it1.pos_out_basket_ * it1.basket_size_ + it1.pos_in_basket_ <
-         it2.pos_out_basket_ * it2.basket_size_ + it2.pos_in_basket_;
+  return (it1.pos_out_basket_ << it1.basket_shift_) + it1.pos_in_basket_ <
+         (it2.pos_out_basket_ << it2.basket_shift_) + it2.pos_in_basket_;
 }
 
 template <typename T, bool IsConst1, bool IsConst2>
@@ -319,8 +495,8 @@ inline bool operator>=(const BaseDequeIterator<T, IsConst1>& it1,
 template <typename T, bool IsConst1, bool IsConst2>
 inline bool operator==(const BaseDequeIterator<T, IsConst1>& it1,
                        const BaseDequeIterator<T, IsConst2>& it2) {
-  return it1.pos_out_basket_ * it1.basket_size_ + it1.pos_in_basket_ ==
-         it2.pos_out_basket_ * it2.basket_size_ + it2.pos_in_basket_;
+  return (it1.pos_out_basket_ << it1.basket_shift_) + it1.pos_in_basket_ ==
+         (it2.pos_out_basket_ << it2.basket_shift_) + it2.pos_in_basket_;
 }
 
 template <typename T, bool IsConst1, bool IsConst2>
@@ -335,32 +511,32 @@ inline bool operator!=(const BaseDequeIterator<T, IsConst1>& it1,
 
 template <typename T>
 inline void Deque<T>::push_front(const_reference value) {
+  emplace_front(value);
+}
+
+template <typename T>
+inline void Deque<T>::push_front(value_type&& value) {
+  emplace_front(std::move(value));
+}
+
+template <typename T>
+template <typename... Args>
+typename Deque<T>::reference Deque<T>::emplace_front(Args&&... args) {
   if (first_pos_out_basket_ == 0 && first_pos_in_basket_ == 0) {
-    pointer* new_data_ = reinterpret_cast<pointer*>(
-        ::operator new((n_baskets_ + 1) * 2 * sizeof(pointer)));
-    for (size_type from = 0, to = n_baskets_ + 2; from < n_baskets_;
-         ++from, ++to) {
-      new_data_[to] = data_[from];
-    }
-    for (size_type i = 0; i < n_baskets_ + 2; ++i) {
-      new_data_[i] = reinterpret_cast<pointer>(
-          ::operator new(basket_size_ * (sizeof(value_type))));
-    }
-    first_pos_out_basket_ = n_baskets_ + 2;
-    n_baskets_ = (n_baskets_ + 1) * 2;
-    ::operator delete(reinterpret_cast<void*>(data_));
-    data_ = new_data_;
+    make_room(1, 0);
   }
   size_type pos_out_basket_ = (first_pos_in_basket_ == 0)
                                   ? first_pos_out_basket_ - 1
                                   : first_pos_out_basket_;
-  size_type pos_in_basket_ =
-      (first_pos_in_basket_ == 0) ? basket_size_ - 1 : first_pos_in_basket_ - 1;
+  size_type pos_in_basket_ = (first_pos_in_basket_ - 1) & basket_mask_;
 
-  new (&data_[pos_out_basket_][pos_in_basket_]) value_type(value);
+  ensure_basket(pos_out_basket_);
+  new (&data_[pos_out_basket_][pos_in_basket_])
+      value_type(std::forward<Args>(args)...);
   first_pos_out_basket_ = pos_out_basket_;
   first_pos_in_basket_ = pos_in_basket_;
   ++size_;
+  return data_[pos_out_basket_][pos_in_basket_];
 }
 
 template <typename T>
@@ -368,29 +544,35 @@ inline void Deque<T>::pop_front() {
   --size_;
   data_[first_pos_out_basket_][first_pos_in_basket_].~value_type();
   ++first_pos_in_basket_;
-  first_pos_out_basket_ += first_pos_in_basket_ / basket_size_;
-  first_pos_in_basket_ %= basket_size_;
+  if (first_pos_in_basket_ == basket_size_) {
+    release_basket(first_pos_out_basket_);
+    ++first_pos_out_basket_;
+    first_pos_in_basket_ = 0;
+  }
 }
 
 template <typename T>
-void Deque<T>::push_back(const_reference value) {
-  auto [pos_out_basket_, pos_in_basket_] = calc_indexes(size_);
-  if (pos_out_basket_ >= n_baskets_ - 1 && pos_in_basket_ >= basket_size_ - 1) {
-    pointer* new_data_ = reinterpret_cast<pointer*>(
-        ::operator new((n_baskets_ + 1) * 2 * sizeof(pointer)));
-    for (size_type i = 0; i < n_baskets_; ++i) {
-      new_data_[i] = data_[i];
-    }
-    for (size_type i = n_baskets_; i < (n_baskets_ + 1) * 2; ++i) {
-      new_data_[i] = reinterpret_cast<pointer>(
-          ::operator new(basket_size_ * (sizeof(value_type))));
-    }
-    n_baskets_ = (n_baskets_ + 1) * 2;
-    ::operator delete(reinterpret_cast<void*>(data_));
-    data_ = new_data_;
+inline void Deque<T>::push_back(const_reference value) {
+  emplace_back(value);
+}
+
+template <typename T>
+inline void Deque<T>::push_back(value_type&& value) {
+  emplace_back(std::move(value));
+}
+
+template <typename T>
+template <typename... Args>
+typename Deque<T>::reference Deque<T>::emplace_back(Args&&... args) {
+  if (calc_indexes(size_).first >= n_baskets_) {
+    make_room(0, 1);
   }
-  new (&data_[pos_out_basket_][pos_in_basket_]) value_type(value);
+  auto [pos_out_basket_, pos_in_basket_] = calc_indexes(size_);
+  ensure_basket(pos_out_basket_);
+  new (&data_[pos_out_basket_][pos_in_basket_])
+      value_type(std::forward<Args>(args)...);
   ++size_;
+  return data_[pos_out_basket_][pos_in_basket_];
 }
 
 template <typename T>
@@ -398,6 +580,9 @@ void Deque<T>::pop_back() {
   --size_;
   auto [pos_out_basket_, pos_in_basket_] = calc_indexes(size_);
   data_[pos_out_basket_][pos_in_basket_].~value_type();
+  if (pos_in_basket_ == 0) {
+    release_basket(pos_out_basket_);
+  }
 }
 
 template <typename T>
@@ -466,157 +651,237 @@ inline typename Deque<T>::const_reverse_iterator Deque<T>::crend() const {
   return std::reverse_iterator(cbegin());
 }
 
+// The element is built before anything moves, since args may refer to an
+// element of this deque. The side of it holding fewer elements is then
+// shifted: its outermost element is moved (or copied, when its move may
+// throw) into a new slot and the rest follow by move-assignment.
 template <typename T>
-void Deque<T>::insert(iterator it, const_reference value) {
-  if (it == begin()) {
-    push_front(value);
-  } else if (it == end()) {
-    push_back(value);
+template <typename... Args>
+typename Deque<T>::iterator Deque<T>::emplace(const_iterator cit,
+                                              Args&&... args) {
+  size_type pos = cit - cbegin();
+  if (pos == 0) {
+    emplace_front(std::forward<Args>(args)...);
+    return begin();
+  }
+  if (pos == size_) {
+    emplace_back(std::forward<Args>(args)...);
+    return end() - 1;
+  }
+  value_type value(std::forward<Args>(args)...);
+  if (pos < size_ - pos) {
+    emplace_front(std::move_if_noexcept((*this)[0]));
+    std::move(begin() + 2, begin() + pos + 1, begin() + 1);
   } else {
-    push_back(value);
-    reverse_iterator rit = std::reverse_iterator(it);
-    for (reverse_iterator from = rbegin() + 1, to = rbegin(); from <= rit;
-         ++from, ++to) {
-      new (&(*to)) value_type(*from);
-    }
-    new (&(*it)) value_type(value);
+    emplace_back(std::move_if_noexcept((*this)[size_ - 1]));
+    std::move_backward(begin() + pos, end() - 2, end() - 1);
   }
+  iterator it = begin() + pos;
+  *it = std::move(value);
+  return it;
+}
+
+template <typename T>
+void Deque<T>::insert(iterator it, const_reference value) {
+  emplace(it, value);
 }
 
 template <typename T>
 void Deque<T>::insert(const_iterator cit, const_reference value) {
-  insert(cit.remove_const(), value);
+  emplace(cit, value);
 }
 
 template <typename T>
-void Deque<T>::erase(const iterator& it) {
-  if (it == begin()) {
-    pop_front();
-  } else if (it == end() - 1) {
-    pop_back();
+void Deque<T>::insert(iterator it, value_type&& value) {
+  emplace(it, std::move(value));
+}
+
+template <typename T>
+void Deque<T>::insert(const_iterator cit, value_type&& value) {
+  emplace(cit, std::move(value));
+}
+
+// Inserts [first, last) before it, shifting the side of it holding fewer
+// elements. Every element is moved or constructed exactly once: the new
+// slots take the outermost old elements and the tail of the range, the old
+// slots freed by the shift take the rest of the range. Single-pass
+// iterators are buffered first, since the range is walked from both ends.
+template <typename T>
+template <typename InputIt, typename>
+typename Deque<T>::iterator Deque<T>::insert(const_iterator cit,
+                                             InputIt first, InputIt last) {
+  using category = typename std::iterator_traits<InputIt>::iterator_category;
+  if constexpr (!std::is_base_of<std::bidirectional_iterator_tag,
+                                 category>::value) {
+    Deque<T> buffer;
+    for (; first != last; ++first) {
+      buffer.emplace_back(*first);
+    }
+    return insert(cit, std::make_move_iterator(buffer.begin()),
+                  std::make_move_iterator(buffer.end()));
   } else {
-    it->~value_type();
-    for (iterator from = it + 1, to = it; from != end(); ++from, ++to) {
-      new (&(*(to))) value_type(*from);
+    size_type pos = cit - cbegin();
+    size_type n = std::distance(first, last);
+    if (n == 0) {
+      return begin() + pos;
     }
-    (end() - 1)->~value_type();
-    --size_;
+    if (pos < size_ - pos) {
+      size_type pushed = 0;
+      InputIt mid = first;
+      if (n > pos) {
+        mid = std::next(first, n - pos);
+        for (InputIt it = mid; it != first; ++pushed) {
+          emplace_front(*--it);
+        }
+      }
+      for (size_type i = std::min(n, pos); i > 0; --i, ++pushed) {
+        emplace_front(std::move_if_noexcept((*this)[i - 1 + pushed]));
+      }
+      if (n < pos) {
+        std::move(begin() + 2 * n, begin() + pos + n, begin() + n);
+      }
+      std::copy(mid, last, begin() + std::max(pos, n));
+    } else {
+      size_type old_size = size_;
+      size_type n_after = size_ - pos;
+      InputIt mid = last;
+      if (n > n_after) {
+        mid = std::next(first, n_after);
+        for (InputIt it = mid; it != last; ++it) {
+          emplace_back(*it);
+        }
+      }
+      for (size_type i = old_size - std::min(n, n_after); i < old_size; ++i) {
+        emplace_back(std::move_if_noexcept((*this)[i]));
+      }
+      if (n < n_after) {
+        std::move_backward(begin() + pos, begin() + (old_size - n),
+                           begin() + old_size);
+      }
+      std::copy(first, mid, begin() + pos);
+    }
+    return begin() + pos;
   }
 }
 
+template <typename T>
+void Deque<T>::erase(const iterator& it) {
+  erase(it, it + 1);
+}
+
 template <typename T>
 void Deque<T>::erase(const_iterator cit) {
-  erase(cit.remove_const());
+  erase(cit, cit + 1);
+}
+
+// Closes the gap from whichever side holds fewer elements, then pops the
+// vacated slots off that end.
+template <typename T>
+typename Deque<T>::iterator Deque<T>::erase(const_iterator first,
+                                            const_iterator last) {
+  size_type pos = first - cbegin();
+  size_type n = last - first;
+  if (n == 0) {
+    return begin() + pos;
+  }
+  if (pos < size_ - pos - n) {
+    std::move_backward(begin(), begin() + pos, begin() + pos + n);
+    for (size_type i = 0; i < n; ++i) {
+      pop_front();
+    }
+  } else {
+    std::move(begin() + pos + n, end(), begin() + pos);
+    for (size_type i = 0; i < n; ++i) {
+      pop_back();
+    }
+  }
+  return begin() + pos;
 }
 
 template <typename T>
 std::pair<typename Deque<T>::size_type, typename Deque<T>::size_type>
 Deque<T>::calc_indexes(size_type pos) const {
   size_type pos_out_basket_ =
-      first_pos_out_basket_ + (pos + first_pos_in_basket_) / basket_size_;
-  size_type pos_in_basket_ = (pos + first_pos_in_basket_) % basket_size_;
+      first_pos_out_basket_ + ((pos + first_pos_in_basket_) >> basket_shift_);
+  size_type pos_in_basket_ = (pos + first_pos_in_basket_) & basket_mask_;
   return {pos_out_basket_, pos_in_basket_};
 }
 
+// The map is allocated by the first push.
 template <typename T>
 inline Deque<T>::Deque() {
-  size_type size = 0;
-  size_ = size;
-  ++size;
-  first_pos_out_basket_ = 0;
-  first_pos_in_basket_ = 0;
-  n_baskets_ = size / basket_size_ + ((size % basket_size_ == 0) ? 0 : 1);
+  leave_empty();
+}
 
-  create_data();
+template <typename T>
+Deque<T>::Deque(const Deque<T>& other) : Deque() {
+  append_range(other.begin(), other.end());
 }
 
+// Steals the map and the spare baskets; other is left empty with no map.
 template <typename T>
-Deque<T>::Deque(const Deque<T>& other) {
+Deque<T>::Deque(Deque<T>&& other) noexcept {
   n_baskets_ = other.n_baskets_;
   first_pos_out_basket_ = other.first_pos_out_basket_;
   first_pos_in_basket_ = other.first_pos_in_basket_;
+  data_ = other.data_;
   size_ = other.size_;
-
-  size_type counter = 0;
-  try {
-    create_data();
-    for (; counter < size_; ++counter) {
-      auto [pos_out_basket_, pos_in_basket_] = calc_indexes(counter);
-      new (&data_[pos_out_basket_][pos_in_basket_])
-          value_type(other.data_[pos_out_basket_][pos_in_basket_]);
-    }
-  } catch (...) {
-    destroy_n_elements(counter);
-    throw;
-  }
+  n_spare_baskets_ = other.n_spare_baskets_;
+  n_allocated_baskets_ = other.n_allocated_baskets_;
+  std::copy(other.spare_baskets_, other.spare_baskets_ + n_spare_baskets_,
+            spare_baskets_);
+  other.leave_empty();
 }
 
 template <typename T>
-Deque<T>::Deque(size_type size) {
-  size_ = size;
-  ++size;
-  first_pos_out_basket_ = 0;
-  first_pos_in_basket_ = 0;
-  n_baskets_ = size / basket_size_ + ((size % basket_size_ == 0) ? 0 : 1);
+Deque<T>::Deque(size_type size) : Deque() {
+  resize(size);
+}
 
-  size_type counter = 0;
-  try {
-    create_data();
-    for (; counter < size_; ++counter) {
-      auto [pos_out_basket_, pos_in_basket_] = calc_indexes(counter);
-      new (&data_[pos_out_basket_][pos_in_basket_]) value_type();
-    }
-  } catch (...) {
-    destroy_n_elements(counter);
-    throw;
-  }
+template <typename T>
+Deque<T>::Deque(size_type size, const_reference value) : Deque() {
+  resize(size, value);
 }
 
 template <typename T>
-Deque<T>::Deque(size_type size, const_reference value) {
-  size_ = size;
-  ++size;
-  first_pos_out_basket_ = 0;
-  first_pos_in_basket_ = 0;
-  n_baskets_ = size / basket_size_ + ((size % basket_size_ == 0) ? 0 : 1);
+template <typename InputIt, typename>
+Deque<T>::Deque(InputIt first, InputIt last) : Deque() {
+  append_range(first, last);
+}
 
-  size_type counter = 0;
-  try {
-    create_data();
-    for (; counter < size_; ++counter) {
-      auto [pos_out_basket_, pos_in_basket_] = calc_indexes(counter);
-      new (&data_[pos_out_basket_][pos_in_basket_]) value_type(value);
-    }
-  } catch (...) {
-    destroy_n_elements(counter);
-    throw;
-  }
+template <typename T>
+Deque<T>::Deque(std::initializer_list<T> list) : Deque() {
+  append_range(list.begin(), list.end());
 }
 
+// Copy-and-swap: safe on self-assignment and leaves *this untouched if a
+// copy throws.
 template <typename T>
 Deque<T>& Deque<T>::operator=(const Deque<T>& other) {
-  destroy_n_elements(size_);
-
-  n_baskets_ = other.n_baskets_;
-  first_pos_out_basket_ = other.first_pos_out_basket_;
-  first_pos_in_basket_ = other.first_pos_in_basket_;
-  size_ = other.size_;
+  Deque<T> copy(other);
+  swap(copy);
+  return *this;
+}
 
-  size_type counter = 0;
-  try {
-    create_data();
-    for (; counter < size_; ++counter) {
-      auto [pos_out_basket_, pos_in_basket_] = calc_indexes(counter);
-      new (&data_[pos_out_basket_][pos_in_basket_])
-          value_type(other.data_[pos_out_basket_][pos_in_basket_]);
-    }
-  } catch (...) {
-    destroy_n_elements(counter);
-    throw;
-  }
+template <typename T>
+Deque<T>& Deque<T>::operator=(Deque<T>&& other) noexcept {
+  Deque<T> stolen(std::move(other));
+  swap(stolen);
   return *this;
 }
 
+template <typename T>
+void Deque<T>::swap(Deque<T>& other) noexcept {
+  std::swap(n_baskets_, other.n_baskets_);
+  std::swap(first_pos_out_basket_, other.first_pos_out_basket_);
+  std::swap(first_pos_in_basket_, other.first_pos_in_basket_);
+  std::swap(data_, other.data_);
+  std::swap(size_, other.size_);
+  std::swap(spare_baskets_, other.spare_baskets_);
+  std::swap(n_spare_baskets_, other.n_spare_baskets_);
+  std::swap(n_allocated_baskets_, other.n_allocated_baskets_);
+}
+
 template <typename T>
 Deque<T>::~Deque() {
   destroy_n_elements(size_);
@@ -627,6 +892,203 @@ typename Deque<T>::size_type Deque<T>::size() const {
   return size_;
 }
 
+template <typename T>
+void Deque<T>::resize(size_type size) {
+  if (size < size_) {
+    erase(begin() + size, end());
+  } else {
+    construct_back(size - size_,
+                   [](pointer place) { new (place) value_type(); });
+  }
+}
+
+template <typename T>
+void Deque<T>::resize(size_type size, const_reference value) {
+  if (size < size_) {
+    erase(begin() + size, end());
+  } else {
+    construct_back(size - size_,
+                   [&value](pointer place) { new (place) value_type(value); });
+  }
+}
+
+// Allocates the map slots and baskets for n_elements more elements at the
+// back, so the pushes that follow neither reallocate nor allocate.
+template <typename T>
+void Deque<T>::reserve_back(size_type n_elements) {
+  if (n_elements == 0) {
+    return;
+  }
+  if (calc_indexes(size_ + n_elements - 1).first >= n_baskets_) {
+    make_room(0, n_elements);
+  }
+  size_type last_pos_out_basket = calc_indexes(size_ + n_elements - 1).first;
+  for (size_type i = calc_indexes(size_).first; i <= last_pos_out_basket; ++i) {
+    ensure_basket(i);
+  }
+}
+
+template <typename T>
+void Deque<T>::reserve_front(size_type n_elements) {
+  if (n_elements == 0) {
+    return;
+  }
+  if (n_elements >
+      (first_pos_out_basket_ << basket_shift_) + first_pos_in_basket_) {
+    make_room(n_elements, 0);
+  }
+  size_type first_pos =
+      (first_pos_out_basket_ << basket_shift_) + first_pos_in_basket_;
+  size_type last_pos_out_basket = (first_pos - 1) >> basket_shift_;
+  for (size_type i = (first_pos - n_elements) >> basket_shift_;
+       i <= last_pos_out_basket; ++i) {
+    ensure_basket(i);
+  }
+}
+
+// Frees the spare baskets and every basket outside the elements, then
+// moves the live baskets into a map of exactly their size. An empty deque
+// gives up its map as well.
+template <typename T>
+void Deque<T>::shrink_to_fit() {
+  for (size_type i = 0; i < n_spare_baskets_; ++i) {
+    free_basket(spare_baskets_[i]);
+  }
+  n_spare_baskets_ = 0;
+  if (data_ == nullptr) {
+    return;
+  }
+  size_type live_first = first_pos_out_basket_;
+  size_type live_end =
+      (size_ == 0) ? live_first : calc_indexes(size_ - 1).first + 1;
+  for (size_type i = 0; i < n_baskets_; ++i) {
+    if ((i < live_first || i >= live_end) && data_[i] != nullptr) {
+      free_basket(data_[i]);
+      data_[i] = nullptr;
+    }
+  }
+  if (size_ == 0) {
+    ::operator delete(reinterpret_cast<void*>(data_));
+    leave_empty();
+    return;
+  }
+  size_type n_live = live_end - live_first;
+  if (n_live < n_baskets_) {
+    pointer* new_data =
+        reinterpret_cast<pointer*>(::operator new(n_live * sizeof(pointer)));
+    std::copy(data_ + live_first, data_ + live_end, new_data);
+    ::operator delete(reinterpret_cast<void*>(data_));
+    data_ = new_data;
+    n_baskets_ = n_live;
+    first_pos_out_basket_ = 0;
+  }
+}
+
+template <typename T>
+typename Deque<T>::size_type Deque<T>::allocated_baskets() const {
+  return n_allocated_baskets_;
+}
+
+template <typename T>
+typename Deque<T>::size_type Deque<T>::map_size() const {
+  return n_baskets_;
+}
+
+template <typename T>
+typename Deque<T>::size_type Deque<T>::memory_usage() const {
+  return n_allocated_baskets_ * basket_size_ * sizeof(value_type) +
+         n_baskets_ * sizeof(pointer);
+}
+
+// Builds the new contents aside and swaps them in, like operator=: a
+// throwing copy leaves *this untouched, and [first, last) may point into
+// *this.
+template <typename T>
+template <typename InputIt, typename>
+void Deque<T>::assign(InputIt first, InputIt last) {
+  Deque<T> assigned(first, last);
+  swap(assigned);
+}
+
+// Forward ranges are sized up front: the map and baskets are reserved once
+// and filled basket by basket, with one memcpy per basket when T is
+// trivially copyable and the source is contiguous or another Deque. Other
+// forward ranges go through construct_back(), so a throwing copy leaves the
+// Deque as it was.
+template <typename T>
+template <typename InputIt, typename>
+void Deque<T>::append_range(InputIt first, InputIt last) {
+  using category = typename std::iterator_traits<InputIt>::iterator_category;
+  if constexpr (!std::is_base_of<std::forward_iterator_tag, category>::value) {
+    for (; first != last; ++first) {
+      emplace_back(*first);
+    }
+  } else if constexpr ((std::is_same<InputIt, iterator>::value ||
+                        std::is_same<InputIt, const_iterator>::value) &&
+                       std::is_trivially_copyable<T>::value) {
+    reserve_back(last - first);
+    for_each_segment(first, last, [this](const T* begin, const T* end) {
+      append_range(begin, end);
+    });
+  } else if constexpr (is_memcpy_source_<InputIt>) {
+    size_type n_elements = last - first;
+    reserve_back(n_elements);
+    for_each_segment(end(), end() + n_elements,
+                     [&first](T* place, T* place_end) {
+                       std::memcpy(place, first,
+                                   (place_end - place) * sizeof(T));
+                       first += place_end - place;
+                     });
+    size_ += n_elements;
+  } else {
+    construct_back(std::distance(first, last), [&first](pointer place) {
+      new (place) value_type(*first);
+      ++first;
+    });
+  }
+}
+
+template <typename T>
+template <typename InputIt, typename>
+void Deque<T>::prepend_range(InputIt first, InputIt last) {
+  using category = typename std::iterator_traits<InputIt>::iterator_category;
+  if constexpr (!std::is_base_of<std::forward_iterator_tag, category>::value) {
+    Deque<T> buffer(first, last);
+    prepend_range(std::make_move_iterator(buffer.begin()),
+                  std::make_move_iterator(buffer.end()));
+  } else {
+    size_type n_elements = std::distance(first, last);
+    reserve_front(n_elements);
+    iterator new_begin = begin() - n_elements;
+    size_type n_built = 0;
+    try {
+      for_each_segment(new_begin, begin(), [&](pointer place,
+                                               pointer place_end) {
+        if constexpr (is_memcpy_source_<InputIt>) {
+          std::memcpy(place, first, (place_end - place) * sizeof(T));
+          first += place_end - place;
+          n_built += place_end - place;
+        } else {
+          for (; place != place_end; ++place, ++first, ++n_built) {
+            new (place) value_type(*first);
+          }
+        }
+      });
+    } catch (...) {
+      for (iterator it = new_begin; n_built > 0; ++it, --n_built) {
+        it->~value_type();
+      }
+      throw;
+    }
+    size_type first_pos =
+        (first_pos_out_basket_ << basket_shift_) + first_pos_in_basket_ -
+        n_elements;
+    first_pos_out_basket_ = first_pos >> basket_shift_;
+    first_pos_in_basket_ = first_pos & basket_mask_;
+    size_ += n_elements;
+  }
+}
+
 template <typename T>
 typename Deque<T>::reference Deque<T>::operator[](size_type pos) {
   auto [pos_out_basket_, pos_in_basket_] = calc_indexes(pos);
@@ -655,10 +1117,7 @@ typename Deque<T>::const_reference Deque<T>::at(size_type pos) const {
 
 template <typename T>
 inline void Deque<T>::check_range(size_type pos) const {
-  size_type lower_bound =
-      first_pos_out_basket_ * basket_size_ + first_pos_in_basket_;
-  size_type upper_bound = lower_bound + size_;
-  if (pos < lower_bound || pos >= upper_bound) {
+  if (pos >= size_) {
     throw std::out_of_range("index out of range");
   }
 }
@@ -669,18 +1128,279 @@ inline void Deque<T>::destroy_n_elements(size_type n_elements) {
     auto [pos_out_basket_, pos_in_basket_] = calc_indexes(pos);
     data_[pos_out_basket_][pos_in_basket_].~value_type();
   }
-  for (size_type i = 0; i < n_baskets_; ++i) {
-    ::operator delete(reinterpret_cast<void*>(data_[i]));
+  if (data_ != nullptr) {
+    for (size_type i = 0; i < n_baskets_; ++i) {
+      if (data_[i] != nullptr) {
+        free_basket(data_[i]);
+      }
+    }
   }
+  for (size_type i = 0; i < n_spare_baskets_; ++i) {
+    free_basket(spare_baskets_[i]);
+  }
+  n_spare_baskets_ = 0;
   ::operator delete(reinterpret_cast<void*>(data_));
+  data_ = nullptr;
 }
 
+// The state of a new or moved-from deque: no map and no baskets. The first
+// push allocates a map through make_room().
 template <typename T>
-inline void Deque<T>::create_data() {
-  data_ =
-      reinterpret_cast<pointer*>(::operator new(n_baskets_ * sizeof(pointer)));
-  for (size_type i = 0; i < n_baskets_; ++i) {
-    data_[i] = reinterpret_cast<pointer>(
-        ::operator new(basket_size_ * (sizeof(value_type))));
+inline void Deque<T>::leave_empty() {
+  n_baskets_ = 0;
+  first_pos_out_basket_ = 0;
+  first_pos_in_basket_ = 0;
+  data_ = nullptr;
+  size_ = 0;
+  n_spare_baskets_ = 0;
+  n_allocated_baskets_ = 0;
+}
+
+// Makes map slots for front_elements more elements before the first one
+// and back_elements more after the last one. The live baskets, together
+// with reserved baskets next to them, are moved to the middle of the map
+// while the result fills at most half of it, so a queue drifting through
+// the map never reallocates it; otherwise the map grows to twice what is
+// needed. Stray baskets elsewhere are released.
+template <typename T>
+void Deque<T>::make_room(size_type front_elements, size_type back_elements) {
+  size_type live_first = first_pos_out_basket_;
+  size_type live_end = live_first;
+  if (n_baskets_ > 0) {
+    live_end = std::min(calc_indexes((size_ == 0) ? 0 : size_ - 1).first,
+                        n_baskets_ - 1) + 1;
+    while (live_first > 0 && data_[live_first - 1] != nullptr) {
+      --live_first;
+    }
+    while (live_end < n_baskets_ && data_[live_end] != nullptr) {
+      ++live_end;
+    }
+  }
+  size_type n_live = live_end - live_first;
+
+  size_type have_front = first_pos_out_basket_ - live_first;
+  size_type have_end = live_end - first_pos_out_basket_;
+  size_type need_front =
+      (front_elements > first_pos_in_basket_)
+          ? (front_elements - first_pos_in_basket_ + basket_mask_) >>
+                basket_shift_
+          : 0;
+  size_type need_end =
+      (size_ + back_elements == 0)
+          ? 0
+          : ((first_pos_in_basket_ + size_ + back_elements - 1) >>
+             basket_shift_) + 1;
+  size_type front_slots =
+      (need_front > have_front) ? need_front - have_front : 0;
+  size_type back_slots = (need_end > have_end) ? need_end - have_end : 0;
+  size_type n_needed = n_live + front_slots + back_slots;
+
+  size_type new_n_baskets = n_baskets_;
+  if (2 * n_needed > n_baskets_) {
+    new_n_baskets = std::max((n_baskets_ + 1) * 2, 2 * n_needed);
+  }
+  size_type new_first = front_slots + (new_n_baskets - n_needed) / 2;
+  if (new_n_baskets == n_baskets_) {
+    for (size_type i = 0; i < n_baskets_; ++i) {
+      if ((i < live_first || i >= live_end) && data_[i] != nullptr) {
+        release_basket(i);
+      }
+    }
+    if (new_first < live_first) {
+      std::copy(data_ + live_first, data_ + live_end, data_ + new_first);
+    } else {
+      std::copy_backward(data_ + live_first, data_ + live_end,
+                         data_ + new_first + n_live);
+    }
+    std::fill(data_, data_ + new_first, nullptr);
+    std::fill(data_ + new_first + n_live, data_ + n_baskets_, nullptr);
+  } else {
+    pointer* new_data = reinterpret_cast<pointer*>(
+        ::operator new(new_n_baskets * sizeof(pointer)));
+    for (size_type i = 0; i < n_baskets_; ++i) {
+      if ((i < live_first || i >= live_end) && data_[i] != nullptr) {
+        release_basket(i);
+      }
+    }
+    std::fill(new_data, new_data + new_n_baskets, nullptr);
+    std::copy(data_ + live_first, data_ + live_end, new_data + new_first);
+    ::operator delete(reinterpret_cast<void*>(data_));
+    data_ = new_data;
+    n_baskets_ = new_n_baskets;
+  }
+  first_pos_out_basket_ = new_first + have_front;
+}
+
+// Constructs n_elements new elements at the back, with construct(place)
+// building each one in place, basket by basket. If a construction throws,
+// the elements built so far are destroyed again.
+template <typename T>
+template <typename Construct>
+void Deque<T>::construct_back(size_type n_elements, Construct construct) {
+  reserve_back(n_elements);
+  size_type old_size = size_;
+  try {
+    for_each_segment(end(), end() + n_elements,
+                     [&](pointer place, pointer place_end) {
+                       for (; place != place_end; ++place) {
+                         construct(place);
+                         ++size_;
+                       }
+                     });
+  } catch (...) {
+    while (size_ > old_size) {
+      pop_back();
+    }
+    throw;
+  }
+}
+
+template <typename T>
+inline typename Deque<T>::pointer Deque<T>::acquire_basket() {
+  if (n_spare_baskets_ > 0) {
+    return spare_baskets_[--n_spare_baskets_];
+  }
+  pointer basket = reinterpret_cast<pointer>(
+      ::operator new(basket_size_ * (sizeof(value_type))));
+  ++n_allocated_baskets_;
+  return basket;
+}
+
+template <typename T>
+inline void Deque<T>::free_basket(pointer basket) {
+  ::operator delete(reinterpret_cast<void*>(basket));
+  --n_allocated_baskets_;
+}
+
+// Baskets are allocated only when the first element is written to them.
+template <typename T>
+inline void Deque<T>::ensure_basket(size_type pos_out_basket) {
+  if (data_[pos_out_basket] == nullptr) {
+    data_[pos_out_basket] = acquire_basket();
   }
 }
+
+template <typename T>
+inline void Deque<T>::release_basket(size_type pos_out_basket) {
+  pointer basket = data_[pos_out_basket];
+  data_[pos_out_basket] = nullptr;
+  if (n_spare_baskets_ < max_spare_baskets_) {
+    spare_baskets_[n_spare_baskets_++] = basket;
+  } else {
+    free_basket(basket);
+  }
+}
+
+//=========================================================================================
+//                              SEGMENTED ALGORITHMS
+//=========================================================================================
+
+// Calls func(begin, end) with pointers bounding each contiguous run of
+// [first, last), in order.
+template <typename T, bool IsConst, typename Func>
+void for_each_segment(BaseDequeIterator<T, IsConst> first,
+                      BaseDequeIterator<T, IsConst> last, Func func) {
+  using size_type = typename BaseDequeIterator<T, IsConst>::size_type;
+  const size_type basket_size = BaseDequeIterator<T, IsConst>::basket_size_;
+  size_type pos_in_basket = first.pos_in_basket_;
+  for (size_type pos_out_basket = first.pos_out_basket_;
+       pos_out_basket < last.pos_out_basket_; ++pos_out_basket) {
+    auto begin = first.basket(pos_out_basket);
+    func(begin + pos_in_basket, begin + basket_size);
+    pos_in_basket = 0;
+  }
+  if (pos_in_basket < last.pos_in_basket_) {
+    auto begin = first.basket(last.pos_out_basket_);
+    func(begin + pos_in_basket, begin + last.pos_in_basket_);
+  }
+}
+
+// As for_each_segment(), but stops once func returns false.
+template <typename T, bool IsConst, typename Func>
+void for_each_segment_while(BaseDequeIterator<T, IsConst> first,
+                            BaseDequeIterator<T, IsConst> last, Func func) {
+  using size_type = typename BaseDequeIterator<T, IsConst>::size_type;
+  const size_type basket_size = BaseDequeIterator<T, IsConst>::basket_size_;
+  size_type pos_in_basket = first.pos_in_basket_;
+  for (size_type pos_out_basket = first.pos_out_basket_;
+       pos_out_basket < last.pos_out_basket_; ++pos_out_basket) {
+    auto begin = first.basket(pos_out_basket);
+    if (!func(begin + pos_in_basket, begin + basket_size)) {
+      return;
+    }
+    pos_in_basket = 0;
+  }
+  if (pos_in_basket < last.pos_in_basket_) {
+    auto begin = first.basket(last.pos_out_basket_);
+    func(begin + pos_in_basket, begin + last.pos_in_basket_);
+  }
+}
+
+template <typename T, bool IsConst, typename OutputIt>
+OutputIt copy(BaseDequeIterator<T, IsConst> first,
+              BaseDequeIterator<T, IsConst> last, OutputIt out) {
+  for_each_segment(first, last, [&out](auto begin, auto end) {
+    out = std::copy(begin, end, out);
+  });
+  return out;
+}
+
+template <typename T>
+BaseDequeIterator<T, false> copy(const T* first, const T* last,
+                                 BaseDequeIterator<T, false> out) {
+  BaseDequeIterator<T, false> out_last = out + (last - first);
+  for_each_segment(out, out_last, [&first](T* begin, T* end) {
+    std::copy(first, first + (end - begin), begin);
+    first += end - begin;
+  });
+  return out_last;
+}
+
+template <typename T, bool IsConst>
+BaseDequeIterator<T, false> copy(BaseDequeIterator<T, IsConst> first,
+                                 BaseDequeIterator<T, IsConst> last,
+                                 BaseDequeIterator<T, false> out) {
+  for_each_segment(first, last, [&out](const T* begin, const T* end) {
+    out = copy(begin, end, out);
+  });
+  return out;
+}
+
+template <typename T, typename U>
+void fill(BaseDequeIterator<T, false> first, BaseDequeIterator<T, false> last,
+          const U& value) {
+  for_each_segment(first, last, [&value](T* begin, T* end) {
+    std::fill(begin, end, value);
+  });
+}
+
+template <typename T, bool IsConst, typename U>
+BaseDequeIterator<T, IsConst> find(BaseDequeIterator<T, IsConst> first,
+                                   BaseDequeIterator<T, IsConst> last,
+                                   const U& value) {
+  std::ptrdiff_t offset = 0;
+  for_each_segment_while(first, last, [&](const T* begin, const T* end) {
+    const T* match = std::find(begin, end, value);
+    offset += match - begin;
+    return match == end;
+  });
+  return first + offset;
+}
+
+template <typename T, bool IsConst, typename Acc>
+Acc accumulate(BaseDequeIterator<T, IsConst> first,
+               BaseDequeIterator<T, IsConst> last, Acc init) {
+  for_each_segment(first, last, [&init](const T* begin, const T* end) {
+    init = std::accumulate(begin, end, std::move(init));
+  });
+  return init;
+}
+
+template <typename T, bool IsConst, typename Acc, typename BinaryOp>
+Acc accumulate(BaseDequeIterator<T, IsConst> first,
+               BaseDequeIterator<T, IsConst> last, Acc init, BinaryOp op) {
+  for_each_segment(first, last, [&init, &op](const T* begin, const T* end) {
+    init = std::accumulate(begin, end, std::move(init), op);
+  });
+  return init;
+}
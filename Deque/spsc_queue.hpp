@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "deque.hpp"
+
+//=========================================================================================
+//                                    DECLARATION
+//=========================================================================================
+
+// Lock-free queue for exactly one producer thread and one consumer thread,
+// for handing work between them without a mutex. Elements live in baskets
+// of DequeBasketSize<T>::value elements, as in Deque, linked into a list.
+// The producer fills the tail basket and publishes how far it got through
+// the basket's release index; the consumer reads up to that index with
+// acquire and hands emptied baskets back to the producer for reuse.
+template <typename T>
+class SpscQueue {
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T&;
+  using const_reference = const T&;
+
+  SpscQueue();
+  SpscQueue(const SpscQueue<T>& other) = delete;
+  SpscQueue& operator=(const SpscQueue<T>& other) = delete;
+
+  ~SpscQueue();
+
+  // Producer side.
+  void push(const_reference value);
+  void push(value_type&& value);
+  template <typename... Args>
+  void emplace(Args&&... args);
+  void push_n(const T* values, size_type n_values);
+
+  // Consumer side. Both return without waiting when the queue is empty.
+  bool try_pop(reference value);
+  size_type pop_n(T* values, size_type max_values);
+
+ private:
+  struct Basket {
+    T* slot(size_type pos);
+
+    // Number of elements the producer has constructed in this basket.
+    std::atomic<size_type> published{0};
+    std::atomic<Basket*> next{nullptr};
+    alignas(T) unsigned char storage[DequeBasketSize<T>::value * sizeof(T)];
+  };
+
+  void advance_tail();
+  bool refresh_head();
+  Basket* acquire_basket();
+  void release_basket(Basket* basket);
+
+  static const size_type basket_size_ = DequeBasketSize<T>::value;
+  static const size_type cache_line_ = 64;
+
+  // Emptied baskets travel back to the producer through a ring of this
+  // size; the consumer frees them once it is full.
+  static const size_type max_spare_baskets_ = 8;
+
+  // Producer-owned.
+  alignas(cache_line_) Basket* tail_;
+  size_type tail_pos_ = 0;
+  std::atomic<size_type> spare_begin_{0};
+
+  // Consumer-owned.
+  alignas(cache_line_) Basket* head_;
+  size_type head_pos_ = 0;
+  size_type head_limit_ = 0;
+  std::atomic<size_type> spare_end_{0};
+
+  Basket* spare_baskets_[max_spare_baskets_];
+};
+
+//=========================================================================================
+//                                SpscQueue DEFINITION
+//=========================================================================================
+
+template <typename T>
+inline T* SpscQueue<T>::Basket::slot(size_type pos) {
+  return reinterpret_cast<T*>(storage) + pos;
+}
+
+template <typename T>
+SpscQueue<T>::SpscQueue() {
+  tail_ = new Basket;
+  head_ = tail_;
+}
+
+// Runs with both threads finished, so the relaxed loads see every write.
+template <typename T>
+SpscQueue<T>::~SpscQueue() {
+  size_type pos = head_pos_;
+  for (Basket* basket = head_; basket != nullptr; pos = 0) {
+    size_type end = basket->published.load(std::memory_order_relaxed);
+    std::destroy(basket->slot(pos), basket->slot(end));
+    Basket* next = basket->next.load(std::memory_order_relaxed);
+    delete basket;
+    basket = next;
+  }
+  size_type spare_end = spare_end_.load(std::memory_order_relaxed);
+  for (size_type i = spare_begin_.load(std::memory_order_relaxed);
+       i != spare_end; ++i) {
+    delete spare_baskets_[i % max_spare_baskets_];
+  }
+}
+
+template <typename T>
+inline void SpscQueue<T>::push(const_reference value) {
+  emplace(value);
+}
+
+template <typename T>
+inline void SpscQueue<T>::push(value_type&& value) {
+  emplace(std::move(value));
+}
+
+template <typename T>
+template <typename... Args>
+void SpscQueue<T>::emplace(Args&&... args) {
+  if (tail_pos_ == basket_size_) {
+    advance_tail();
+  }
+  new (tail_->slot(tail_pos_)) value_type(std::forward<Args>(args)...);
+  ++tail_pos_;
+  tail_->published.store(tail_pos_, std::memory_order_release);
+}
+
+// Copies values into the tail basket a basketful at a time and publishes
+// each basket once.
+template <typename T>
+void SpscQueue<T>::push_n(const T* values, size_type n_values) {
+  while (n_values > 0) {
+    if (tail_pos_ == basket_size_) {
+      advance_tail();
+    }
+    size_type count = std::min(n_values, basket_size_ - tail_pos_);
+    std::uninitialized_copy(values, values + count, tail_->slot(tail_pos_));
+    tail_pos_ += count;
+    tail_->published.store(tail_pos_, std::memory_order_release);
+    values += count;
+    n_values -= count;
+  }
+}
+
+template <typename T>
+bool SpscQueue<T>::try_pop(reference value) {
+  if (head_pos_ == head_limit_ && !refresh_head()) {
+    return false;
+  }
+  T* slot = head_->slot(head_pos_);
+  value = std::move(*slot);
+  slot->~value_type();
+  ++head_pos_;
+  return true;
+}
+
+// Moves up to max_values elements into values and returns how many it
+// moved.
+template <typename T>
+typename SpscQueue<T>::size_type SpscQueue<T>::pop_n(T* values,
+                                                     size_type max_values) {
+  size_type n_popped = 0;
+  while (n_popped < max_values) {
+    if (head_pos_ == head_limit_ && !refresh_head()) {
+      break;
+    }
+    size_type count = std::min(max_values - n_popped, head_limit_ - head_pos_);
+    T* slot = head_->slot(head_pos_);
+    std::move(slot, slot + count, values + n_popped);
+    std::destroy(slot, slot + count);
+    head_pos_ += count;
+    n_popped += count;
+  }
+  return n_popped;
+}
+
+// The new basket's indexes are reset before the release store of next,
+// which publishes them to the consumer together with the basket.
+template <typename T>
+void SpscQueue<T>::advance_tail() {
+  Basket* basket = acquire_basket();
+  basket->published.store(0, std::memory_order_relaxed);
+  basket->next.store(nullptr, std::memory_order_relaxed);
+  tail_->next.store(basket, std::memory_order_release);
+  tail_ = basket;
+  tail_pos_ = 0;
+}
+
+// Called once the consumer has used up everything it saw published. Moves
+// on to the next basket when the current one is exhausted; the producer
+// links the next basket only after filling this one, so a missing link
+// means the queue is empty.
+template <typename T>
+bool SpscQueue<T>::refresh_head() {
+  if (head_pos_ < basket_size_) {
+    head_limit_ = head_->published.load(std::memory_order_acquire);
+    return head_pos_ < head_limit_;
+  }
+  Basket* next = head_->next.load(std::memory_order_acquire);
+  if (next == nullptr) {
+    return false;
+  }
+  release_basket(head_);
+  head_ = next;
+  head_pos_ = 0;
+  head_limit_ = next->published.load(std::memory_order_acquire);
+  return head_limit_ > 0;
+}
+
+template <typename T>
+typename SpscQueue<T>::Basket* SpscQueue<T>::acquire_basket() {
+  size_type begin = spare_begin_.load(std::memory_order_relaxed);
+  if (begin == spare_end_.load(std::memory_order_acquire)) {
+    return new Basket;
+  }
+  Basket* basket = spare_baskets_[begin % max_spare_baskets_];
+  spare_begin_.store(begin + 1, std::memory_order_release);
+  return basket;
+}
+
+template <typename T>
+void SpscQueue<T>::release_basket(Basket* basket) {
+  size_type end = spare_end_.load(std::memory_order_relaxed);
+  if (end - spare_begin_.load(std::memory_order_acquire) ==
+      max_spare_baskets_) {
+    delete basket;
+    return;
+  }
+  spare_baskets_[end % max_spare_baskets_] = basket;
+  spare_end_.store(end + 1, std::memory_order_release);
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+//=========================================================================================
+//                                    DECLARATION
+//=========================================================================================
+
+// Chase-Lev work-stealing deque, in the C11 formulation of Le, Pop, Cohen
+// and Zappa Nardelli. The owning thread pushes and pops at the bottom, any
+// other thread steals from the top. A thief reads its slot before it claims
+// it, so the value may be overwritten under it; T is therefore limited to
+// trivially copyable types such as task pointers or small task descriptors.
+//
+// The elements live in a circular array that doubles when it fills up.
+// Thieves may still be reading a replaced array, so replaced arrays are
+// kept until the deque itself is destroyed; as they halve in size, this
+// at most doubles the memory held.
+template <typename T>
+class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "WorkStealingDeque needs a trivially copyable T");
+
+ public:
+  using value_type = T;
+  using size_type = size_t;
+
+  explicit WorkStealingDeque(size_type capacity = 64);
+  WorkStealingDeque(const WorkStealingDeque<T>& other) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque<T>& other) = delete;
+
+  ~WorkStealingDeque() = default;
+
+  // Owner thread only.
+  void push(const T& value);
+  std::optional<T> pop();
+
+  // Any thread. Returns nothing when the deque is empty or another thread
+  // won the race for the top element.
+  std::optional<T> steal();
+
+  // Exact only while no other thread is operating on the deque.
+  size_type size() const;
+  bool empty() const;
+
+ private:
+  class CircularArray {
+   public:
+    explicit CircularArray(size_type capacity);
+
+    size_type capacity() const;
+    T get(std::ptrdiff_t pos) const;
+    void put(std::ptrdiff_t pos, const T& value);
+
+   private:
+    size_type mask_;
+    std::unique_ptr<std::atomic<T>[]> slots_;
+  };
+
+  void grow(std::ptrdiff_t top, std::ptrdiff_t bottom);
+
+  static const size_type cache_line_ = 64;
+
+  alignas(cache_line_) std::atomic<std::ptrdiff_t> top_{0};
+  alignas(cache_line_) std::atomic<std::ptrdiff_t> bottom_{0};
+  std::atomic<CircularArray*> array_;
+
+  // Every array allocated so far, the current one last. Owner-only.
+  std::vector<std::unique_ptr<CircularArray>> arrays_;
+};
+
+//=========================================================================================
+//                              CircularArray DEFINITION
+//=========================================================================================
+
+template <typename T>
+WorkStealingDeque<T>::CircularArray::CircularArray(size_type capacity)
+    : mask_(capacity - 1), slots_(new std::atomic<T>[capacity]) {}
+
+template <typename T>
+inline typename WorkStealingDeque<T>::size_type
+WorkStealingDeque<T>::CircularArray::capacity() const {
+  return mask_ + 1;
+}
+
+template <typename T>
+inline T WorkStealingDeque<T>::CircularArray::get(std::ptrdiff_t pos) const {
+  return slots_[pos & mask_].load(std::memory_order_relaxed);
+}
+
+template <typename T>
+inline void WorkStealingDeque<T>::CircularArray::put(std::ptrdiff_t pos,
+                                                     const T& value) {
+  slots_[pos & mask_].store(value, std::memory_order_relaxed);
+}
+
+//=========================================================================================
+//                            WorkStealingDeque DEFINITION
+//=========================================================================================
+
+// The capacity is rounded up to a power of two.
+template <typename T>
+WorkStealingDeque<T>::WorkStealingDeque(size_type capacity) {
+  size_type power = 1;
+  while (power < capacity) {
+    power *= 2;
+  }
+  arrays_.emplace_back(new CircularArray(power));
+  array_.store(arrays_.back().get(), std::memory_order_relaxed);
+}
+
+template <typename T>
+void WorkStealingDeque<T>::push(const T& value) {
+  std::ptrdiff_t bottom = bottom_.load(std::memory_order_relaxed);
+  std::ptrdiff_t top = top_.load(std::memory_order_acquire);
+  CircularArray* array = array_.load(std::memory_order_relaxed);
+  if (bottom - top >= static_cast<std::ptrdiff_t>(array->capacity())) {
+    grow(top, bottom);
+    array = array_.load(std::memory_order_relaxed);
+  }
+  array->put(bottom, value);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+}
+
+// Reserves the bottom slot first, then checks whether a thief got there.
+// Only the last element can be contended; owner and thieves settle it with
+// a CAS on top.
+template <typename T>
+std::optional<T> WorkStealingDeque<T>::pop() {
+  std::ptrdiff_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  CircularArray* array = array_.load(std::memory_order_relaxed);
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::ptrdiff_t top = top_.load(std::memory_order_relaxed);
+  if (top > bottom) {
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  T value = array->get(bottom);
+  if (top == bottom) {
+    bool won = top_.compare_exchange_strong(top, top + 1,
+                                            std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    if (!won) {
+      return std::nullopt;
+    }
+  }
+  return value;
+}
+
+template <typename T>
+std::optional<T> WorkStealingDeque<T>::steal() {
+  std::ptrdiff_t top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::ptrdiff_t bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return std::nullopt;
+  }
+  CircularArray* array = array_.load(std::memory_order_acquire);
+  T value = array->get(top);
+  if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+template <typename T>
+typename WorkStealingDeque<T>::size_type WorkStealingDeque<T>::size() const {
+  std::ptrdiff_t bottom = bottom_.load(std::memory_order_relaxed);
+  std::ptrdiff_t top = top_.load(std::memory_order_relaxed);
+  return (bottom > top) ? bottom - top : 0;
+}
+
+template <typename T>
+bool WorkStealingDeque<T>::empty() const {
+  return size() == 0;
+}
+
+// Copies the live range [top, bottom) into an array twice as large. Slots
+// keep their positions modulo the capacity, so thieves holding either
+// array read the same values.
+template <typename T>
+void WorkStealingDeque<T>::grow(std::ptrdiff_t top, std::ptrdiff_t bottom) {
+  CircularArray* old_array = array_.load(std::memory_order_relaxed);
+  arrays_.emplace_back(new CircularArray(2 * old_array->capacity()));
+  CircularArray* new_array = arrays_.back().get();
+  for (std::ptrdiff_t pos = top; pos < bottom; ++pos) {
+    new_array->put(pos, old_array->get(pos));
+  }
+  array_.store(new_array, std::memory_order_release);
+}
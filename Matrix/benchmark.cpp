@@ -0,0 +1,153 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+
+#include "matrix.h"
+
+// Benchmarks operator*, det, rank and inverted over several fields and
+// sizes. Prints one JSON array of results to stdout:
+//   ./benchmark [min_ms_per_case]
+
+std::atomic<size_t> allocations{0};
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+// Kept out of line: once inlined next to the counting operator new, GCC
+// flags the malloc/free pairing as mismatched.
+__attribute__((noinline)) void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+template <typename Field>
+struct FieldInfo;
+
+template <>
+struct FieldInfo<Rational> {
+  static std::string name() { return "Rational"; }
+  static Rational random(std::mt19937_64 &rng) {
+    return Rational(static_cast<int>(rng() % 19) - 9);
+  }
+};
+
+template <size_t P>
+struct FieldInfo<Residue<P>> {
+  static std::string name() { return "Residue<" + std::to_string(P) + ">"; }
+  static Residue<P> random(std::mt19937_64 &rng) {
+    return Residue<P>(static_cast<int>(rng() % P));
+  }
+};
+
+template <>
+struct FieldInfo<double> {
+  static std::string name() { return "double"; }
+  static double random(std::mt19937_64 &rng) {
+    return std::uniform_real_distribution<double>(-1.0, 1.0)(rng);
+  }
+};
+
+double min_ns = 2e8;
+bool first_record = true;
+volatile size_t sink = 0;
+
+template <typename Op>
+void run_case(const std::string &field, const std::string &op, size_t n,
+              Op &&body) {
+  body();
+  size_t iterations = 0;
+  size_t allocs_before = allocations.load();
+  auto start = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  do {
+    body();
+    ++iterations;
+    elapsed = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  } while (elapsed < min_ns);
+  size_t allocs = allocations.load() - allocs_before;
+  std::cout << (first_record ? "[\n" : ",\n");
+  first_record = false;
+  std::cout << "  {\"field\": \"" << field << "\", \"op\": \"" << op
+            << "\", \"n\": " << n << ", \"iterations\": " << iterations
+            << ", \"ns_per_op\": " << static_cast<size_t>(elapsed / iterations)
+            << ", \"allocs_per_op\": "
+            << static_cast<double>(allocs) / iterations << "}";
+  std::cout.flush();
+}
+
+// Random entries over Residue<10007> or small rationals give a singular
+// matrix often enough for inverted() to throw mid-run, so a is built as
+// L * U: L unit lower triangular, U upper triangular with a nonzero
+// diagonal.
+template <size_t N, typename Field>
+void fill_invertible(SquareMatrix<N, Field> &a, std::mt19937_64 &rng) {
+  using Info = FieldInfo<Field>;
+  auto lower = std::make_unique<SquareMatrix<N, Field>>();
+  auto upper = std::make_unique<SquareMatrix<N, Field>>();
+  for (size_t i = 0; i < N; ++i) {
+    (*lower)[i][i] = Field(1);
+    do {
+      (*upper)[i][i] = Info::random(rng);
+    } while ((*upper)[i][i] == Field(0));
+    for (size_t j = 0; j < i; ++j) {
+      (*lower)[i][j] = Info::random(rng);
+      (*upper)[j][i] = Info::random(rng);
+    }
+  }
+  a = *lower * *upper;
+}
+
+// Matrices of the larger sizes do not fit on the stack, so every operand
+// lives on the heap.
+template <size_t N, typename Field>
+void bench_size(std::mt19937_64 &rng) {
+  using Info = FieldInfo<Field>;
+  auto a = std::make_unique<SquareMatrix<N, Field>>();
+  auto b = std::make_unique<SquareMatrix<N, Field>>();
+  auto res = std::make_unique<SquareMatrix<N, Field>>();
+  fill_invertible(*a, rng);
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      (*b)[i][j] = Info::random(rng);
+    }
+  }
+  run_case(Info::name(), "operator*", N, [&] { *res = *a * *b; });
+  run_case(Info::name(), "det", N,
+           [&] { sink = sink + (a->det() == Field(0)); });
+  run_case(Info::name(), "rank", N, [&] { sink = sink + a->rank(); });
+  run_case(Info::name(), "inverted", N, [&] { *res = a->inverted(); });
+}
+
+template <typename Field, size_t... Sizes>
+void bench_field(std::mt19937_64 &rng) {
+  (bench_size<Sizes, Field>(rng), ...);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    min_ns = std::atof(argv[1]) * 1e6;
+  }
+  std::mt19937_64 rng(2023);
+  bench_field<double, 4, 8, 16, 32, 64, 128, 256, 512>(rng);
+  bench_field<Residue<10007>, 4, 8, 16, 32, 64, 128, 256, 512>(rng);
+  bench_field<Residue<998244353>, 4, 8, 16, 32, 64, 128, 256, 512>(rng);
+  // Exact rational elimination grows the numbers with n, so the sizes stop
+  // earlier.
+  bench_field<Rational, 4, 8, 16>(rng);
+  std::cout << "\n]\n";
+}
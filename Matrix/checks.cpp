@@ -0,0 +1,383 @@
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+
+// Behaviour checks against values computed independently with exact
+// fractions. Every block prints its name once its asserts have passed, so
+// build without NDEBUG.
+
+const size_t kPrime = 998244353;
+using Mod = Residue<kPrime>;
+
+SquareMatrix<5> rational_m1() {
+  return {{46, 56, 27, 32, 48},
+          {19, 55, 57, 69, 43},
+          {11, 93, 47, 47, 29},
+          {14, 41, 75, 53, 55},
+          {96, 10, 43, 12, 50}};
+}
+
+template <typename Field>
+SquareMatrix<3, Field> identity3() {
+  return {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+}
+
+template <size_t N>
+SquareMatrix<N, Mod> random_mod_matrix(std::mt19937_64 &rng) {
+  SquareMatrix<N, Mod> m;
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      m[i][j] = Mod(static_cast<int>(rng() % kPrime));
+    }
+  }
+  return m;
+}
+
+int main() {
+  {
+    SquareMatrix<5> m1 = rational_m1();
+    SquareMatrix<4> m2 = {
+        {79, 26, 73, 14}, {26, 23, 88, 35}, {95, 45, 79, 90}, {94, 11, 46, 68}};
+    SquareMatrix<3> m3 = {{0, 0, 1}, {0, 1, 0}, {1, 0, 0}};
+    assert(m1.det() == Rational(-258662784));
+    assert(m2.det() == Rational(-9807294));
+    assert(m3.det() == Rational(-1));
+    assert(m1.rank() == 5);
+    SquareMatrix<5> halves = rational_m1();
+    halves *= Rational(1) / Rational(2);
+    assert(halves.det() == Rational(-258662784) / Rational(32));
+    SquareMatrix<5, BigInteger> integral = {{46, 56, 27, 32, 48},
+                                            {19, 55, 57, 69, 43},
+                                            {11, 93, 47, 47, 29},
+                                            {14, 41, 75, 53, 55},
+                                            {96, 10, 43, 12, 50}};
+    assert(integral.bareiss_det() == BigInteger(-258662784));
+    Matrix<3, 4, BigInteger> wide = {{1, 2, 3, 4}, {2, 4, 6, 8}, {0, 1, 1, 1}};
+    assert(wide.rank() == 2);
+    std::cout << "bareiss det and rank" << '\n';
+  }
+  {
+    SquareMatrix<5, BigInteger> m = {{46, 56, 27, 32, 48},
+                                     {19, 55, 57, 69, 43},
+                                     {11, 93, 47, 47, 29},
+                                     {14, 41, 75, 53, 55},
+                                     {96, 10, 43, 12, 50}};
+    assert(multimodular_det(m) == BigInteger(-258662784));
+    assert(multimodular_det(m, true) == BigInteger(-258662784));
+    SquareMatrix<5> halves = rational_m1();
+    halves *= Rational(1) / Rational(2);
+    assert(multimodular_det(halves) ==
+           Rational(-258662784) / Rational(32));
+    std::array<Rational, 5> b = {Rational(271), Rational(659) / Rational(2),
+                                 Rational(269) / Rational(2),
+                                 Rational(917) / Rational(2), Rational(461)};
+    std::array<Rational, 5> x = {Rational(1), Rational(-2), Rational(3),
+                                 Rational(1) / Rational(2), Rational(5)};
+    assert(multimodular_solve(rational_m1(), b) == x);
+    std::cout << "crt det and solve" << '\n';
+  }
+  {
+    SquareMatrix<5> m1 = rational_m1();
+    std::array<Rational, 5> b = {Rational(271), Rational(659) / Rational(2),
+                                 Rational(269) / Rational(2),
+                                 Rational(917) / Rational(2), Rational(461)};
+    std::array<Rational, 5> x = {Rational(1), Rational(-2), Rational(3),
+                                 Rational(1) / Rational(2), Rational(5)};
+    LUDecomposition<5, Rational> factors(m1);
+    assert((factors.solve(b) == x));
+    assert(factors.det() == Rational(-258662784));
+    SquareMatrix<3> singular = {{1, 2, 3}, {2, 4, 6}, {1, 1, 1}};
+    LUDecomposition<3, Rational> lu(singular);
+    assert(lu.isSingular() && lu.rank() == 2 && lu.det() == Rational(0));
+    bool thrown = false;
+    try {
+      lu.solve(std::array<Rational, 3>{});
+    } catch (const std::exception &) {
+      thrown = true;
+    }
+    assert(thrown);
+    std::cout << "lu solve" << '\n';
+  }
+  {
+    SquareMatrix<3> m = {{2, -1, 0}, {-1, 2, -1}, {0, -1, 2}};
+    SquareMatrix<3> expected = {{3, 2, 1}, {2, 4, 2}, {1, 2, 3}};
+    expected *= Rational(1) / Rational(4);
+    SquareMatrix<3> inv = m;
+    inv.invert();
+    assert(inv == expected);
+    assert(m * inv == identity3<Rational>());
+    assert(m.inverted() == expected);
+    SquareMatrix<3, Residue<7>> mod7 = {{2, 6, 0}, {6, 2, 6}, {0, 6, 2}};
+    assert(mod7 * mod7.inverted() == identity3<Residue<7>>());
+    SquareMatrix<3> singular = {{1, 2, 3}, {2, 4, 6}, {1, 1, 1}};
+    bool thrown = false;
+    try {
+      singular.invert();
+    } catch (const std::exception &) {
+      thrown = true;
+    }
+    assert(thrown);
+    std::cout << "in-place inverse" << '\n';
+  }
+  {
+    ThreadPool pool(2);
+    SquareMatrix<5> m1 = rational_m1();
+    assert(m1.det(&pool) == Rational(-258662784));
+    assert(m1.rank(&pool) == 5);
+    assert(m1.inverted(&pool) == m1.inverted());
+    SquareMatrix<3, Residue<7>> mod7 = {{2, 6, 0}, {6, 2, 6}, {0, 6, 2}};
+    assert(mod7.det(&pool) == mod7.det());
+    std::cout << "pool elimination" << '\n';
+  }
+  {
+    ThreadPool pool(2);
+    Matrix<3, 2, Residue<7>> tall = {{1, 2}, {2, 4}, {3, 6}};
+    assert(tall.rank() == 1);
+    tall[2][1] = Residue<7>(5);
+    assert(tall.rank(&pool) == 2);
+    Matrix<2, 4, double> wide = {{0, 0, 1, 2}, {0, 0, 2, 4}};
+    assert(wide.rank() == 1);
+    std::cout << "non-square rank" << '\n';
+  }
+  {
+    SquareMatrix<3> a = {{1, 2, 3}, {4, 5, 6}, {7, 8, 10}};
+    SquareMatrix<3> b = identity3<Rational>();
+    SquareMatrix<3> expected = {{2, 2, 3}, {4, 6, 6}, {7, 8, 11}};
+    SquareMatrix<3> sum = a + b;
+    assert(sum == expected);
+    SquareMatrix<3> combined = a - Rational(2) * b + b * Rational(1);
+    SquareMatrix<3> difference = a - b;
+    assert(combined == difference);
+    SquareMatrix<3> transposed = transpose(a);
+    assert(transposed == a.transposed());
+    a = a + transpose(a);
+    assert(a == a.transposed());
+    std::cout << "lazy expressions" << '\n';
+  }
+  {
+    SquareMatrix<3> a = {{1, 2, 3}, {4, 5, 6}, {7, 8, 10}};
+    SquareMatrix<3> b = identity3<Rational>();
+    SquareMatrix<3> sum = {{2, 2, 3}, {4, 6, 6}, {7, 8, 11}};
+    assert(a + b == sum);
+    assert((a + b).det() == sum.det());
+    assert((a + b).rank() == 3);
+    assert(transpose(a) == a.transposed());
+    assert(a - Rational(2) * b + b == a - b);
+    SquareMatrix<3> c = {{0, 1, 0}, {2, 0, 1}, {1, 1, 1}};
+    assert((a + b) * c == sum * c);
+    assert(c * (a - b) == c * (a + Rational(-1) * b));
+    assert((a + b) * (a - b) == a * a - b * b);
+    assert(transpose(c) * c == c.transposed() * c);
+    SquareMatrix<3, Residue<7>> p = {{1, 2, 3}, {4, 5, 6}, {0, 1, 2}};
+    SquareMatrix<3, Residue<7>> q = {{3, 0, 1}, {1, 1, 0}, {2, 5, 4}};
+    SquareMatrix<3, Residue<7>> pq = p * q;
+    assert(Residue<7>(2) * p * q == pq + pq);
+    assert(p * q * Residue<7>(2) == pq + pq);
+    std::cout << "expressions as matrices" << '\n';
+  }
+  {
+    SquareMatrix<3> a = {{1, 2, 3}, {4, 5, 6}, {7, 8, 10}};
+    assert(pow(a, 5) == a * a * a * a * a);
+    assert(pow(a, 0) == identity3<Rational>());
+    using F = Residue<1000000007>;
+    std::vector<F> coeffs = {F(1), F(1)};
+    std::vector<F> init = {F(0), F(1)};
+    assert(linear_recurrence(coeffs, init, 90) == F(210345902));
+    std::cout << "powers and recurrences" << '\n';
+  }
+  {
+    std::mt19937_64 rng(7);
+    SquareMatrix<24, Mod> dense;
+    for (size_t i = 0; i < 24; ++i) {
+      dense[i][i] = Mod(static_cast<int>(rng() % 1000 + 1));
+      for (size_t k = 0; k < 3; ++k) {
+        dense[i][rng() % 24] = Mod(static_cast<int>(rng() % 1000));
+      }
+    }
+    SparseMatrix<Mod> sparse(dense);
+    assert((sparse.toDense<24, 24>() == dense));
+    assert(wiedemann_det(sparse) == dense.det());
+    assert(wiedemann_rank(sparse) == dense.rank());
+    for (size_t j = 0; j < 24; ++j) {
+      dense[5][j] = dense[3][j] + dense[4][j];
+    }
+    SparseMatrix<Mod> deficient(dense);
+    assert(wiedemann_det(deficient) == Mod(0));
+    assert(wiedemann_rank(deficient) == 23);
+    std::cout << "wiedemann" << '\n';
+  }
+  {
+    std::mt19937_64 rng(3);
+    SquareMatrix<40, Mod> a = random_mod_matrix<40>(rng);
+    SquareMatrix<40, Mod> b = random_mod_matrix<40>(rng);
+    SquareMatrix<40, Mod> expected;
+    for (size_t i = 0; i < 40; ++i) {
+      for (size_t k = 0; k < 40; ++k) {
+        for (size_t j = 0; j < 40; ++j) {
+          expected[i][j] += a[i][k] * b[k][j];
+        }
+      }
+    }
+    assert(a * b == expected);
+    SquareMatrix<40, Mod> identity;
+    for (size_t i = 0; i < 40; ++i) {
+      identity[i][i] = Mod(1);
+    }
+    assert(a * a.inverted() == identity);
+    assert((a * b).det() == a.det() * b.det());
+    std::cout << "residue kernels" << '\n';
+  }
+  {
+    static_assert(is_prime<7> && is_prime<2> && !is_prime<9>);
+    static_assert(primitive_root<998244353> == 3);
+    static_assert(primitive_root<1000000007> == 5);
+    Residue<998244353> a(5), b(7);
+    assert(a / b * b == a);
+    std::cout << "primes and roots" << '\n';
+  }
+  {
+    static_assert(is_prime<65537> && !is_prime<65535>);
+    static_assert(is_prime_modulus<998244353> && !is_prime_modulus<561>);
+    static_assert(is_prime_modulus<18446744073709551557ull>);
+    std::cout << "prime moduli" << '\n';
+  }
+  {
+    SquareMatrix<3> a = {{1, 2, 3}, {4, 5, 6}, {7, 8, 10}};
+    std::vector<Rational> expected = {Rational(3), Rational(-12),
+                                      Rational(-16), Rational(1)};
+    assert(charpoly(a) == expected);
+    assert(minpoly(a) == expected);
+    SquareMatrix<3> diagonal = {{1, 0, 0}, {0, 1, 0}, {0, 0, 2}};
+    std::vector<Rational> diagonal_min = {Rational(2), Rational(-3),
+                                          Rational(1)};
+    assert(minpoly(diagonal) == diagonal_min);
+    assert(pow_by_charpoly(a, 5) == pow(a, 5));
+    assert(trace_of_power(a, 5) == pow(a, 5).trace());
+    std::cout << "charpoly and minpoly" << '\n';
+  }
+  {
+    SquareMatrix<4, Residue<2>> nilpotent = {
+        {0, 1, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 1}, {0, 0, 0, 0}};
+    std::vector<Residue<2>> square = {Residue<2>(0), Residue<2>(0),
+                                      Residue<2>(1)};
+    assert(minpoly(nilpotent) == square);
+    SquareMatrix<3> jordan = {{2, 1, 0}, {0, 2, 0}, {0, 0, 2}};
+    std::vector<Rational> jordan_min = {Rational(4), Rational(-4),
+                                        Rational(1)};
+    assert(minpoly(jordan) == jordan_min);
+    std::cout << "derogatory minpoly" << '\n';
+  }
+  {
+    Matrix<4, 5> m;
+    for (size_t i = 0; i < 4; ++i) {
+      for (size_t j = 0; j < 5; ++j) {
+        m[i][j] = Rational(static_cast<int>(i * 5 + j));
+      }
+    }
+    Rational column_sum(0);
+    for (const Rational &x : m.column(2)) {
+      column_sum += x;
+    }
+    assert(column_sum == Rational(38));
+    const Matrix<4, 5> &cm = m;
+    assert(dot(cm.row(1), cm.row(2)) == Rational(430));
+    m.row(0) *= Rational(2);
+    assert(m[0][4] == Rational(8));
+    Matrix<2, 2> block = m.submatrix<2, 2>(1, 1);
+    Matrix<2, 2> expected = {{6, 7}, {11, 12}};
+    assert(block == expected);
+    std::cout << "views" << '\n';
+  }
+  {
+    std::mt19937_64 rng(11);
+    std::vector<Mod> a(300), b(200);
+    for (Mod &c : a) {
+      c = Mod(static_cast<int>(rng() % kPrime));
+    }
+    for (Mod &c : b) {
+      c = Mod(static_cast<int>(rng() % kPrime));
+    }
+    std::vector<Mod> expected(a.size() + b.size() - 1, Mod(0));
+    for (size_t i = 0; i < a.size(); ++i) {
+      for (size_t j = 0; j < b.size(); ++j) {
+        expected[i + j] += a[i] * b[j];
+      }
+    }
+    Polynomial<Mod> prod = Polynomial<Mod>(a) * Polynomial<Mod>(b);
+    assert(prod.coefficients() == expected);
+    Polynomial<Mod> rem = prod % Polynomial<Mod>(b);
+    assert(rem.degree() < 0);
+    assert(prod / Polynomial<Mod>(b) == Polynomial<Mod>(a));
+    std::cout << "ntt" << '\n';
+  }
+  {
+    const std::string path = "checks_matrix.bin";
+    SquareMatrix<5> m1 = rational_m1();
+    m1[2][3] = Rational(-7) / Rational(3);
+    save_binary(path, m1);
+    SquareMatrix<5> loaded;
+    load_binary(path, loaded);
+    assert(loaded == m1);
+    SquareMatrix<4, Mod> wrong;
+    bool thrown = false;
+    try {
+      load_binary(path, wrong);
+    } catch (const std::exception &) {
+      thrown = true;
+    }
+    assert(thrown);
+    std::string text = " 1 -2/4\n  3\t 00 ";
+    Matrix<2, 2> parsed;
+    parse_matrix(text.data(), text.data() + text.size(), parsed);
+    Matrix<2, 2> expected = {{1, 0}, {3, 0}};
+    expected[0][1] = Rational(-1) / Rational(2);
+    assert(parsed == expected);
+    std::remove(path.c_str());
+    std::cout << "checkpoint round-trip" << '\n';
+  }
+  {
+    UnsignedBigInteger big("123456789012345678901234567890");
+    assert(UnsignedBigInteger::from_chunks(big.chunks()) == big);
+    std::vector<uint64_t> padded = big.chunks();
+    padded.push_back(0);
+    padded.push_back(0);
+    assert(UnsignedBigInteger::from_chunks(padded) == big);
+    assert(UnsignedBigInteger::from_chunks({}) == UnsignedBigInteger(0));
+    std::cout << "chunk round-trip" << '\n';
+  }
+  {
+    const std::string path = "checks_truncated.bin";
+    SquareMatrix<1, BigInteger> m = {{5}};
+    save_binary(path, m);
+    std::string bytes;
+    {
+      std::ifstream in(path, std::ios::binary);
+      bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    // The last entry is one chunk: its count sits just before it.
+    const uint32_t huge_count = 0xFFFFFFFF;
+    bytes.replace(bytes.size() - 8, 4,
+                  reinterpret_cast<const char *>(&huge_count), 4);
+    {
+      std::ofstream out(path, std::ios::binary);
+      out << bytes;
+    }
+    SquareMatrix<1, BigInteger> loaded;
+    std::string message;
+    try {
+      load_binary(path, loaded);
+    } catch (const std::runtime_error &e) {
+      message = e.what();
+    }
+    assert(message == "load_binary: truncated file");
+    std::remove(path.c_str());
+    std::cout << "truncated chunk count" << '\n';
+  }
+}
+
@@ -1,9 +1,33 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #pragma once
 
+// Build with -DMATRIX_NO_X86_KERNELS to fall back to the portable loops.
+#ifndef MATRIX_NO_X86_KERNELS
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MATRIX_X86_KERNELS
+#endif
+#endif
+
 /*
 ================================================================================
 
@@ -16,6 +40,7 @@ class UnsignedBigInteger {
  public:
   UnsignedBigInteger(uint64_t n = 1);
   UnsignedBigInteger(const std::string &str);
+  UnsignedBigInteger(const char *first, const char *last);
   UnsignedBigInteger(const UnsignedBigInteger &ubi) = default;
   ~UnsignedBigInteger() = default;
 
@@ -28,8 +53,12 @@ class UnsignedBigInteger {
   UnsignedBigInteger &shift_chunk(int64_t shift);
   UnsignedBigInteger times(uint64_t n) const;
   UnsignedBigInteger divide(uint64_t n) const;
+  uint64_t mod(uint64_t n) const;
+  double log2() const;
   uint64_t size() const;
   static uint64_t chunk_size();
+  const std::vector<uint64_t> &chunks() const;
+  static UnsignedBigInteger from_chunks(std::vector<uint64_t> chunks);
 
   UnsignedBigInteger &operator+=(const UnsignedBigInteger &ubi);
   UnsignedBigInteger &operator-=(const UnsignedBigInteger &ubi);
@@ -66,20 +95,34 @@ UnsignedBigInteger::UnsignedBigInteger(uint64_t n) : data_() {
 }
 
 UnsignedBigInteger::UnsignedBigInteger(const std::string &str)
-    : data_(str.size() / chunk_size_ + ((str.size() % chunk_size_) ? 1 : 0)) {
-  if (str[0] == '-') {
+    : UnsignedBigInteger(str.data(), str.data() + str.size()) {}
+
+// Parses the decimal digits in [first, last) straight into chunks, with no
+// temporary strings.
+UnsignedBigInteger::UnsignedBigInteger(const char *first, const char *last)
+    : data_() {
+  if (first != last && *first == '-') {
     throw std::invalid_argument("string start with '-'\n");
   }
-  for (int64_t i = str.size() - chunk_size_, j = 0; i >= 0;
-       i -= chunk_size_, ++j) {
-    data_[j] = std::stoi(str.substr(i, chunk_size_));
+  if (first == last) {
+    throw std::invalid_argument("UnsignedBigInteger: empty number");
   }
-  if (str.size() % chunk_size_ != 0) {
-    data_[str.size() / chunk_size_] =
-        std::stoi(str.substr(0, str.size() % chunk_size_));
+  while (last - first > 1 && *first == '0') {
+    ++first;
   }
-  for (int64_t i = data_.size() - 1; i > 0 && data_[i] == 0; --i) {
-    data_.pop_back();
+  const int64_t chunk_len = static_cast<int64_t>(chunk_size_);
+  data_.reserve((last - first + chunk_len - 1) / chunk_len);
+  for (const char *end = last; end > first;) {
+    const char *begin = (end - first > chunk_len) ? end - chunk_len : first;
+    uint64_t chunk = 0;
+    for (const char *c = begin; c < end; ++c) {
+      if (*c < '0' || *c > '9') {
+        throw std::invalid_argument("UnsignedBigInteger: not a digit");
+      }
+      chunk = chunk * 10 + static_cast<uint64_t>(*c - '0');
+    }
+    data_.push_back(chunk);
+    end = begin;
   }
 }
 
@@ -250,6 +293,24 @@ UnsignedBigInteger UnsignedBigInteger::times(uint64_t n) const {
   }
   return ubi.delete_leading_zeros();
 }
+uint64_t UnsignedBigInteger::mod(uint64_t n) const {
+  uint64_t rem = 0;
+  for (int64_t i = data_.size() - 1; i >= 0; --i) {
+    rem = (rem * chunk_ + data_[i]) % n;
+  }
+  return rem;
+}
+
+double UnsignedBigInteger::log2() const {
+  size_t top = data_.size() - 1;
+  double lead = static_cast<double>(data_[top]);
+  if (top > 0) {
+    lead = lead * chunk_ + data_[top - 1];
+    --top;
+  }
+  return std::log2(lead) + top * std::log2(static_cast<double>(chunk_));
+}
+
 UnsignedBigInteger UnsignedBigInteger::divide(uint64_t n) const {
   std::vector<uint64_t> ans(data_.size(), 0);
   uint64_t add = 0;
@@ -354,6 +415,27 @@ uint64_t UnsignedBigInteger::size() const { return data_.size(); }
 
 uint64_t UnsignedBigInteger::chunk_size() { return chunk_size_; }
 
+const std::vector<uint64_t> &UnsignedBigInteger::chunks() const {
+  return data_;
+}
+
+// Base 10^9 chunks, least significant first.
+UnsignedBigInteger UnsignedBigInteger::from_chunks(
+    std::vector<uint64_t> chunks) {
+  UnsignedBigInteger ubi;
+  ubi.data_ = std::move(chunks);
+  if (ubi.data_.empty()) {
+    ubi.data_.push_back(0);
+  }
+  for (uint64_t chunk : ubi.data_) {
+    if (chunk >= chunk_) {
+      throw std::invalid_argument("UnsignedBigInteger: chunk out of range");
+    }
+  }
+  ubi.delete_leading_zeros();
+  return ubi;
+}
+
 std::ostream &operator<<(std::ostream &os, const UnsignedBigInteger &ubi) {
   os << ubi.toString();
   return os;
@@ -381,6 +463,7 @@ class BigInteger {
  public:
   BigInteger(int64_t n = 1);
   BigInteger(const std::string &str);
+  BigInteger(const char *first, const char *last);
   BigInteger(const UnsignedBigInteger &ubi);
   BigInteger(const BigInteger &bi) = default;
   ~BigInteger() = default;
@@ -418,8 +501,18 @@ BigInteger::BigInteger(int64_t n)
     : ubi_(std::abs(n)), type_((n < 0) ? Type::negative : Type::positive) {}
 
 BigInteger::BigInteger(const std::string &str)
-    : ubi_((str[0] == '-') ? str.substr(1) : str),
-      type_((str[0] == '-') ? Type::negative : Type::positive) {}
+    : BigInteger(str.data(), str.data() + str.size()) {}
+
+BigInteger::BigInteger(const char *first, const char *last)
+    : ubi_((first != last && (*first == '-' || *first == '+')) ? first + 1
+                                                                : first,
+           last),
+      type_((first != last && *first == '-') ? Type::negative
+                                             : Type::positive) {
+  if (ubi_ == 0) {
+    type_ = Type::positive;
+  }
+}
 
 BigInteger::BigInteger(const UnsignedBigInteger &ubi)
     : ubi_(ubi), type_(Type::positive) {}
@@ -634,6 +727,7 @@ class Rational {
  public:
   Rational(int64_t n = 1);
   Rational(const BigInteger &bi);
+  Rational(const BigInteger &numer, const BigInteger &denom);
   Rational &operator+=(const Rational &r);
   Rational &operator-=(const Rational &r);
   Rational &operator*=(const Rational &r);
@@ -643,11 +737,14 @@ class Rational {
 
   friend bool operator<(const Rational &r1, const Rational &r2);
   friend bool operator==(const Rational &r1, const Rational &r2);
+  friend void read_entry(const char *&cur, const char *end, Rational &r);
 
   std::string toString();
   std::string asDecimal(size_t precision);
   void correct_sign();
   void reduction();
+  const BigInteger &getNumerator() const;
+  const BigInteger &getDenominator() const;
 
  private:
   BigInteger numerator;
@@ -656,6 +753,15 @@ class Rational {
 
 Rational::Rational(int64_t n) : numerator(n), denominator(1) {}
 Rational::Rational(const BigInteger &bi) : numerator(bi), denominator(1) {}
+Rational::Rational(const BigInteger &numer, const BigInteger &denom)
+    : numerator(numer), denominator(denom) {
+  if (denominator == 0) {
+    throw std::invalid_argument("Rational: zero denominator");
+  }
+  if (denominator != 1) {
+    reduction();
+  }
+}
 
 bool operator<(const Rational &r1, const Rational &r2) {
   if (r1.numerator.sign() != r2.numerator.sign()) {
@@ -768,10 +874,7 @@ void Rational::correct_sign() {
   }
 }
 
-void Rational::reduction() {
-  correct_sign();
-  UnsignedBigInteger a = numerator.abs();
-  UnsignedBigInteger b = denominator.abs();
+UnsignedBigInteger gcd(UnsignedBigInteger a, UnsignedBigInteger b) {
   while (a != 0 && b != 0) {
     if (a > b) {
       a %= b;
@@ -779,12 +882,22 @@ void Rational::reduction() {
       b %= a;
     }
   }
-  numerator /= (a + b);
-  denominator /= (a + b);
+  return a + b;
+}
+
+void Rational::reduction() {
+  correct_sign();
+  UnsignedBigInteger divisor = gcd(numerator.abs(), denominator.abs());
+  numerator /= divisor;
+  denominator /= divisor;
 }
 
 Rational::operator double() { return std::stod(asDecimal(10)); }
 
+const BigInteger &Rational::getNumerator() const { return numerator; }
+
+const BigInteger &Rational::getDenominator() const { return denominator; }
+
 std::ostream &operator<<(std::ostream &os, const Rational &r) {
   os << Rational(r).asDecimal();
   return os;
@@ -844,6 +957,120 @@ struct prime_check<N, 1> {
 template <size_t N>
 const bool is_prime = prime_check<N, Sqrt<N>>::value;
 
+// is_prime needs about 2 sqrt(N) nested instantiations, more than the
+// compiler allows for the word-sized CRT and NTT primes. Moduli from
+// recursive_prime_limit up are checked with Miller-Rabin instead, and NTT
+// roots come from find_primitive_root; both are constexpr functions.
+
+constexpr size_t mul_mod(size_t a, size_t b, size_t n) {
+  return static_cast<size_t>(static_cast<unsigned __int128>(a) * b % n);
+}
+
+constexpr size_t pow_mod(size_t a, size_t e, size_t n) {
+  size_t res = 1 % n;
+  a %= n;
+  for (; e > 0; e >>= 1) {
+    if (e & 1) {
+      res = mul_mod(res, a, n);
+    }
+    a = mul_mod(a, a, n);
+  }
+  return res;
+}
+
+// Deterministic Miller-Rabin: the first twelve primes as bases are enough
+// for every n < 2^64.
+constexpr bool miller_rabin(size_t n) {
+  const size_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  if (n < 2) {
+    return false;
+  }
+  for (size_t b : bases) {
+    if (n % b == 0) {
+      return n == b;
+    }
+  }
+  size_t d = n - 1;
+  size_t s = 0;
+  for (; d % 2 == 0; d /= 2) {
+    ++s;
+  }
+  for (size_t b : bases) {
+    size_t x = pow_mod(b, d, n);
+    if (x == 1 || x == n - 1) {
+      continue;
+    }
+    bool composite = true;
+    for (size_t i = 1; composite && i < s; ++i) {
+      x = mul_mod(x, x, n);
+      composite = (x != n - 1);
+    }
+    if (composite) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Distinct prime factors of n, found by trial division that stops as soon
+// as the cofactor is prime. The cofactor only changes after a division, so
+// it is only retested then. Returns their count; at most 15 fit in 64 bits.
+constexpr size_t prime_factors(size_t n, size_t (&factors)[16]) {
+  size_t count = 0;
+  bool prime_cofactor = miller_rabin(n);
+  for (size_t d = 2; n > 1 && !prime_cofactor && d * d <= n; ++d) {
+    if (n % d != 0) {
+      continue;
+    }
+    factors[count++] = d;
+    while (n % d == 0) {
+      n /= d;
+    }
+    prime_cofactor = miller_rabin(n);
+  }
+  if (n > 1) {
+    factors[count++] = n;
+  }
+  return count;
+}
+
+// Smallest generator of the multiplicative group modulo prime p.
+constexpr size_t find_primitive_root(size_t p) {
+  if (p == 2) {
+    return 1;
+  }
+  size_t factors[16] = {};
+  size_t count = prime_factors(p - 1, factors);
+  for (size_t g = 2;; ++g) {
+    bool generator = true;
+    for (size_t i = 0; generator && i < count; ++i) {
+      generator = (pow_mod(g, (p - 1) / factors[i], p) != 1);
+    }
+    if (generator) {
+      return g;
+    }
+  }
+}
+
+const size_t recursive_prime_limit = size_t(1) << 18;
+
+template <size_t N, bool small = (N < recursive_prime_limit)>
+struct residue_prime {
+  static const bool value = is_prime<N>;
+};
+
+template <size_t N>
+struct residue_prime<N, false> {
+  static const bool value = miller_rabin(N);
+};
+
+// Whether Residue<N> is a field.
+template <size_t N>
+const bool is_prime_modulus = residue_prime<N>::value;
+
+template <size_t N>
+constexpr size_t primitive_root = find_primitive_root(N);
+
 template <size_t N>
 class Residue {
  public:
@@ -901,7 +1128,7 @@ size_t gcd_ext(int64_t a, int64_t b, int64_t &x, int64_t &y) {
 
 template <size_t N>
 Residue<N> &Residue<N>::operator/=(const Residue<N> &r) {
-  static_assert(is_prime<N>, "your number isn't prime");
+  static_assert(is_prime_modulus<N>, "your number isn't prime");
   int64_t x = 0, y = 0;
   gcd_ext(r.val_, N, x, y);
   x *= val_;
@@ -909,6 +1136,16 @@ Residue<N> &Residue<N>::operator/=(const Residue<N> &r) {
   val_ = x % N;
   return *this;
 }
+template <size_t N>
+Residue<N> inverse(const Residue<N> &r) {
+  int64_t x = 0, y = 0;
+  gcd_ext(r.val_, N, x, y);
+  x %= static_cast<int64_t>(N);
+  Residue<N> inv;
+  inv.val_ = (x < 0) ? x + N : x;
+  return inv;
+}
+
 template <size_t N>
 Residue<N> operator+(Residue<N> r1, const Residue<N> &r2) {
   return r1 += r2;
@@ -935,6 +1172,263 @@ template <size_t N>
 bool operator!=(const Residue<N> &r1, const Residue<N> &r2) {
   return !(r1 == r2);
 }
+
+/*
+================================================================================
+
+                              RESIDUE KERNELS
+
+================================================================================
+*/
+
+// Row kernels for Residue<P> with P < 2^31. Products use Shoup's trick: for a
+// fixed multiplier a the precomputed a' = floor(a * 2^32 / P) gives
+// a * x mod P in [0, 2P) with two 32x32->64 multiplies and no division.
+
+template <typename Field>
+const bool is_small_residue = false;
+
+template <size_t P>
+const bool is_small_residue<Residue<P>> = (P > 1 && P < (size_t(1) << 31));
+
+template <typename Field>
+const size_t residue_modulus = 0;
+
+template <size_t P>
+const size_t residue_modulus<Residue<P>> = P;
+
+bool cpu_has_avx2() {
+#ifdef MATRIX_X86_KERNELS
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+#else
+  return false;
+#endif
+}
+
+// a * x mod p in [0, 2p).
+size_t shoup_multiply(size_t a, size_t a_shoup, size_t x, size_t p) {
+  size_t q = (a_shoup * x) >> 32;
+  return a * x - q * p;
+}
+
+// dst[i] = (dst[i] - num * src[i]) mod p.
+void residue_axpy_scalar(size_t *dst, const size_t *src, size_t num, size_t p,
+                         size_t len) {
+  size_t num_shoup = (num << 32) / p;
+  for (size_t i = 0; i < len; ++i) {
+    size_t r = shoup_multiply(num, num_shoup, src[i], p);
+    r -= (r >= p) ? p : 0;
+    size_t y = dst[i] + p - r;
+    dst[i] = y - ((y >= p) ? p : 0);
+  }
+}
+
+// acc[i] += num * src[i] mod p, left in [0, 2p) per step; the caller
+// reduces once after at most 2^32 steps.
+void residue_accumulate_scalar(size_t *acc, const size_t *src, size_t num,
+                               size_t p, size_t len) {
+  size_t num_shoup = (num << 32) / p;
+  for (size_t i = 0; i < len; ++i) {
+    acc[i] += shoup_multiply(num, num_shoup, src[i], p);
+  }
+}
+
+#ifdef MATRIX_X86_KERNELS
+__attribute__((target("avx2"))) void residue_axpy_avx2(size_t *dst,
+                                                       const size_t *src,
+                                                       size_t num, size_t p,
+                                                       size_t len) {
+  size_t num_shoup = (num << 32) / p;
+  const __m256i vnum = _mm256_set1_epi64x(num);
+  const __m256i vshoup = _mm256_set1_epi64x(num_shoup);
+  const __m256i vp = _mm256_set1_epi64x(p);
+  const __m256i vp_less = _mm256_set1_epi64x(p - 1);
+  size_t i = 0;
+  for (; i + 4 <= len; i += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    __m256i q = _mm256_srli_epi64(_mm256_mul_epu32(x, vshoup), 32);
+    __m256i r = _mm256_sub_epi64(_mm256_mul_epu32(x, vnum),
+                                 _mm256_mul_epu32(q, vp));
+    r = _mm256_sub_epi64(r, _mm256_and_si256(_mm256_cmpgt_epi64(r, vp_less), vp));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+    y = _mm256_sub_epi64(_mm256_add_epi64(y, vp), r);
+    y = _mm256_sub_epi64(y, _mm256_and_si256(_mm256_cmpgt_epi64(y, vp_less), vp));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), y);
+  }
+  residue_axpy_scalar(dst + i, src + i, num, p, len - i);
+}
+
+__attribute__((target("avx2"))) void residue_accumulate_avx2(size_t *acc,
+                                                             const size_t *src,
+                                                             size_t num,
+                                                             size_t p,
+                                                             size_t len) {
+  size_t num_shoup = (num << 32) / p;
+  const __m256i vnum = _mm256_set1_epi64x(num);
+  const __m256i vshoup = _mm256_set1_epi64x(num_shoup);
+  const __m256i vp = _mm256_set1_epi64x(p);
+  size_t i = 0;
+  for (; i + 4 <= len; i += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    __m256i q = _mm256_srli_epi64(_mm256_mul_epu32(x, vshoup), 32);
+    __m256i r = _mm256_sub_epi64(_mm256_mul_epu32(x, vnum),
+                                 _mm256_mul_epu32(q, vp));
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + i),
+                        _mm256_add_epi64(a, r));
+  }
+  residue_accumulate_scalar(acc + i, src + i, num, p, len - i);
+}
+#endif
+
+// dst[i] -= num * src[i] for i < len.
+template <typename Field>
+void subtract_scaled_row(Field *dst, const Field *src, const Field &num,
+                         size_t len) {
+  if constexpr (is_small_residue<Field>) {
+    static_assert(sizeof(Field) == sizeof(size_t));
+    size_t *d = &dst->val_;
+    const size_t *s = &src->val_;
+#ifdef MATRIX_X86_KERNELS
+    if (cpu_has_avx2()) {
+      residue_axpy_avx2(d, s, num.val_, residue_modulus<Field>, len);
+      return;
+    }
+#endif
+    residue_axpy_scalar(d, s, num.val_, residue_modulus<Field>, len);
+  } else {
+    for (size_t i = 0; i < len; ++i) {
+      dst[i] -= num * src[i];
+    }
+  }
+}
+
+/*
+================================================================================
+
+                                 THREAD POOL
+
+================================================================================
+*/
+
+// Fixed set of workers for fork-join loops. parallel_for() hands out
+// [first, last) in chunks of grain indices, runs chunks on the calling
+// thread as well and returns once every index has been processed. Tasks
+// must not throw.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t n_threads = std::thread::hardware_concurrency());
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  size_t size() const;
+
+  template <typename Task>
+  void parallel_for(size_t first, size_t last, size_t grain, const Task &task);
+
+ private:
+  void worker_loop();
+  void run_chunks();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const void *task_;
+  void (*invoke_)(const void *task, size_t idx);
+  std::atomic<size_t> next_;
+  size_t last_;
+  size_t grain_;
+  size_t busy_;
+  uint64_t generation_;
+  bool stop_;
+};
+
+ThreadPool::ThreadPool(size_t n_threads)
+    : task_(nullptr),
+      invoke_(nullptr),
+      next_(0),
+      last_(0),
+      grain_(1),
+      busy_(0),
+      generation_(0),
+      stop_(false) {
+  for (size_t i = 1; i < n_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::worker_loop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::size() const { return workers_.size() + 1; }
+
+template <typename Task>
+void ThreadPool::parallel_for(size_t first, size_t last, size_t grain,
+                              const Task &task) {
+  if (workers_.empty() || last <= first + grain) {
+    for (size_t i = first; i < last; ++i) {
+      task(i);
+    }
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    invoke_ = [](const void *task, size_t idx) {
+      (*static_cast<const Task *>(task))(idx);
+    };
+    next_ = first;
+    last_ = last;
+    grain_ = grain;
+    busy_ = workers_.size();
+    ++generation_;
+  }
+  wake_.notify_all();
+  run_chunks();
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]() { return busy_ == 0; });
+}
+
+void ThreadPool::worker_loop() {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+    }
+    run_chunks();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busy_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::run_chunks() {
+  for (size_t begin = next_.fetch_add(grain_); begin < last_;
+       begin = next_.fetch_add(grain_)) {
+    size_t end = std::min(begin + grain_, last_);
+    for (size_t i = begin; i < end; ++i) {
+      invoke_(task_, i);
+    }
+  }
+}
+
 /*
 ================================================================================
 
@@ -943,12 +1437,84 @@ bool operator!=(const Residue<N> &r1, const Residue<N> &r2) {
 ================================================================================
 */
 
+// Fields whose det() and rank() go through fraction-free (Bareiss)
+// elimination: every intermediate entry is a minor of the source matrix, so
+// entry size grows polynomially and every division is exact.
+template <typename Field>
+const bool use_bareiss =
+    std::is_same_v<Field, BigInteger> || std::is_same_v<Field, Rational>;
+
+template <size_t N, typename Field = Rational>
+class LUDecomposition;
+
+// Rows handed to one pool task per pivot step. Big-number row updates are
+// expensive enough to split row by row; word-sized fields are batched to
+// about elimination_chunk entries per task.
+const size_t elimination_chunk = 1 << 14;
+
+template <typename Field>
+size_t elimination_grain(size_t row_len) {
+  if (use_bareiss<Field>) {
+    return 1;
+  }
+  return std::max<size_t>(1, elimination_chunk / std::max<size_t>(1, row_len));
+}
+
+// Applies task to every row in [first, last), on pool if one is given.
+template <typename Field, typename Task>
+void for_each_row(ThreadPool *pool, size_t first, size_t last, size_t row_len,
+                  const Task &task) {
+  if (pool == nullptr) {
+    for (size_t row = first; row < last; ++row) {
+      task(row);
+    }
+    return;
+  }
+  pool->parallel_for(first, last, elimination_grain<Field>(row_len), task);
+}
+
+// CRTP base of everything that can stand on either side of +, - and scalar
+// *: Matrix itself and the lazy nodes in MATRIX EXPRESSIONS. A node keeps
+// its operands and computes entry(i, j) on demand, so a chain like
+// A + B - Field(2) * transpose(C) is evaluated in one pass into the matrix
+// it is assigned to.
+template <typename Expr>
+class MatrixExpr {
+ public:
+  const Expr &self() const { return static_cast<const Expr &>(*this); }
+
+  // Whole-matrix queries on an expression evaluate it into a Matrix first,
+  // so (A + B).det() reads like it does on a Matrix. Matrix hides these
+  // with its own members.
+  auto det(ThreadPool *pool = nullptr) const;
+  auto rank(ThreadPool *pool = nullptr) const;
+  auto inverted(ThreadPool *pool = nullptr) const;
+  auto transposed() const;
+  auto trace() const;
+};
+
+template <typename T>
+class VectorView;
+
+template <size_t R, size_t C, typename T>
+class MatrixView;
+
 template <size_t M, size_t N, typename Field = Rational>
-class Matrix {
+class Matrix : public MatrixExpr<Matrix<M, N, Field>> {
  public:
+  using field_type = Field;
+  static const size_t rows = M;
+  static const size_t cols = N;
+
   Matrix();
   Matrix(const std::initializer_list<std::initializer_list<Field>> &list);
   Matrix(const Matrix<M, N, Field> &other);
+  template <typename Expr>
+  Matrix(const MatrixExpr<Expr> &expr);
+
+  Matrix<M, N, Field> &operator=(const Matrix<M, N, Field> &other) = default;
+  template <typename Expr>
+  Matrix<M, N, Field> &operator=(const MatrixExpr<Expr> &expr);
 
   Matrix<M, N, Field> &operator+=(const Matrix<M, N, Field> &m);
   Matrix<M, N, Field> &operator-=(const Matrix<M, N, Field> &m);
@@ -956,16 +1522,34 @@ class Matrix {
   Matrix<M, N, Field> &operator*=(const Matrix<M, N, Field> &m);
 
   Matrix<N, M, Field> transposed() const;
-  Field det() const;
-  size_t rank() const;
-  Matrix<M, N, Field> inverted() const;
-  void invert();
+  Field det(ThreadPool *pool = nullptr) const;
+  size_t rank(ThreadPool *pool = nullptr) const;
+  Field bareiss_det(ThreadPool *pool = nullptr) const;
+  size_t bareiss_rank(ThreadPool *pool = nullptr) const;
+  Matrix<M, N, Field> inverted(ThreadPool *pool = nullptr) const;
+  void invert(ThreadPool *pool = nullptr);
   Field trace() const;
   std::array<Field, N> getRow(size_t idx) const;
   std::array<Field, M> getColumn(size_t idx) const;
+  VectorView<Field> row(size_t idx);
+  VectorView<const Field> row(size_t idx) const;
+  VectorView<Field> column(size_t idx);
+  VectorView<const Field> column(size_t idx) const;
+  template <size_t R, size_t C>
+  MatrixView<R, C, Field> submatrix(size_t first_row, size_t first_col);
+  template <size_t R, size_t C>
+  MatrixView<R, C, const Field> submatrix(size_t first_row,
+                                          size_t first_col) const;
   std::array<Field, N> &operator[](size_t idx);
   const std::array<Field, N> &operator[](size_t idx) const;
 
+  const Field &entry(size_t i, size_t j) const;
+  bool refers_to(const void *m) const;
+  bool transposes(const void *m) const;
+
+  static size_t bareiss_eliminate(Matrix<M, N, Field> &tmp, bool &odd_swaps,
+                                  ThreadPool *pool);
+
   std::array<std::array<Field, N>, M> data_;
 };
 
@@ -998,6 +1582,36 @@ Matrix<M, N, Field>::Matrix(const Matrix<M, N, Field> &other) {
   data_ = other.data_;
 }
 
+template <size_t M, size_t N, typename Field>
+template <typename Expr>
+Matrix<M, N, Field>::Matrix(const MatrixExpr<Expr> &expr) {
+  static_assert(Expr::rows == M && Expr::cols == N);
+  for (size_t i = 0; i < M; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      data_[i][j] = expr.self().entry(i, j);
+    }
+  }
+}
+
+// Element-wise nodes only read entry (i, j) to produce entry (i, j), so they
+// can be written straight into *this even if they read *this. A transposed
+// view of *this cannot, and goes through a temporary.
+template <size_t M, size_t N, typename Field>
+template <typename Expr>
+Matrix<M, N, Field> &Matrix<M, N, Field>::operator=(
+    const MatrixExpr<Expr> &expr) {
+  static_assert(Expr::rows == M && Expr::cols == N);
+  if (expr.self().transposes(this)) {
+    return *this = Matrix<M, N, Field>(expr);
+  }
+  for (size_t i = 0; i < M; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      data_[i][j] = expr.self().entry(i, j);
+    }
+  }
+  return *this;
+}
+
 template <size_t M, size_t N, typename Field>
 Matrix<M, N, Field> &Matrix<M, N, Field>::operator+=(
     const Matrix<M, N, Field> &m) {
@@ -1030,55 +1644,64 @@ Matrix<M, N, Field> &Matrix<M, N, Field>::operator*=(const Field &f) {
   return *this;
 }
 
-template <size_t M, size_t N, typename Field>
-Matrix<M, N, Field> operator+(Matrix<M, N, Field> m1,
-                              const Matrix<M, N, Field> &m2) {
-  return m1 += m2;
-}
-
-template <size_t M, size_t N, typename Field>
-Matrix<M, N, Field> operator-(Matrix<M, N, Field> m1,
-                              const Matrix<M, N, Field> &m2) {
-  return m1 -= m2;
-}
-
-template <size_t M, size_t N, typename Field>
-Matrix<M, N, Field> operator*(Matrix<M, N, Field> m, const Field &f) {
-  return m *= f;
-}
-
-template <size_t M, size_t N, typename Field>
-Matrix<M, N, Field> operator*(const Field &f, Matrix<M, N, Field> m) {
-  return m *= f;
-}
-
 template <size_t M, size_t N, typename Field>
 Matrix<M, N, Field> &Matrix<M, N, Field>::operator*=(
     const Matrix<M, N, Field> &m1) {
   static_assert(M == N);
   Matrix<M, M, Field> res;
-  for (size_t k = 0; k < M; ++k) {
-    for (size_t m = 0; m < M; ++m) {
-      for (size_t n = 0; n < M; ++n) {
-        res.data_[m][k] += data_[m][n] * m1.data_[n][k];
-      }
-    }
-  }
+  multiply_into(*this, m1, res);
   this->data_ = res.data_;
   return *this;
 }
 
+// res = m1 * m2; res must not alias m1 or m2.
 template <size_t M, size_t N, size_t K, typename Field>
-Matrix<M, K, Field> operator*(const Matrix<M, N, Field> &m1,
-                              const Matrix<N, K, Field> &m2) {
-  Matrix<M, K, Field> res;
-  for (size_t k = 0; k < K; ++k) {
+void multiply_into(const Matrix<M, N, Field> &m1, const Matrix<N, K, Field> &m2,
+                   Matrix<M, K, Field> &res) {
+  if constexpr (is_small_residue<Field> && N < (size_t(1) << 32)) {
+    const size_t p = residue_modulus<Field>;
+    std::array<size_t, K> acc;
     for (size_t m = 0; m < M; ++m) {
+      acc.fill(0);
       for (size_t n = 0; n < N; ++n) {
+        size_t a = m1.data_[m][n].val_;
+        if (a == 0) {
+          continue;
+        }
+#ifdef MATRIX_X86_KERNELS
+        if (cpu_has_avx2()) {
+          residue_accumulate_avx2(acc.data(), &m2.data_[n][0].val_, a, p, K);
+          continue;
+        }
+#endif
+        residue_accumulate_scalar(acc.data(), &m2.data_[n][0].val_, a, p, K);
+      }
+      for (size_t k = 0; k < K; ++k) {
+        res.data_[m][k].val_ = acc[k] % p;
+      }
+    }
+    return;
+  }
+  for (size_t m = 0; m < M; ++m) {
+    for (size_t k = 0; k < K; ++k) {
+      res.data_[m][k] = Field(0);
+    }
+    for (size_t n = 0; n < N; ++n) {
+      if (m1.data_[m][n] == Field(0)) {
+        continue;
+      }
+      for (size_t k = 0; k < K; ++k) {
         res.data_[m][k] += m1.data_[m][n] * m2.data_[n][k];
       }
     }
   }
+}
+
+template <size_t M, size_t N, size_t K, typename Field>
+Matrix<M, K, Field> operator*(const Matrix<M, N, Field> &m1,
+                              const Matrix<N, K, Field> &m2) {
+  Matrix<M, K, Field> res;
+  multiply_into(m1, m2, res);
   return res;
 }
 
@@ -1095,114 +1718,195 @@ Matrix<N, M, Field> Matrix<M, N, Field>::transposed() const {
 
 Rational abs(Rational r) { return (r > 0) ? r : -r; }
 
+// Row in [from, M) to pivot on in column col, or M if the column is zero
+// there. Floating point fields take the largest |a| for stability.
 template <size_t M, size_t N, typename Field>
-Field Matrix<M, N, Field>::det() const {
-  static_assert(M == N);
-  Field ans(1);
-  Matrix<M, N, Field> tmp(*this);
-  for (size_t col = 0; col < M; ++col) {
-    size_t max_row = col;
-    for (size_t under_row = col + 1; under_row < M; ++under_row) {
-      if (abs(tmp[under_row][col]) > abs(tmp[col][col])) {
-        max_row = under_row;
+size_t find_pivot(const Matrix<M, N, Field> &m, size_t col, size_t from) {
+  size_t pivot = from;
+  if constexpr (std::is_floating_point_v<Field>) {
+    for (size_t row = from + 1; row < M; ++row) {
+      if (std::abs(m[row][col]) > std::abs(m[pivot][col])) {
+        pivot = row;
       }
     }
-    if (max_row != col) {
-      ans *= -1;
-      std::swap(tmp[max_row], tmp[col]);
+    return (pivot < M && m[pivot][col] == Field(0)) ? M : pivot;
+  } else {
+    while (pivot < M && m[pivot][col] == Field(0)) {
+      ++pivot;
     }
-    Field el = tmp[col][col];
-    if (el == Field(0)) {
-      return Field(0);
+    return pivot;
+  }
+}
+
+template <size_t M, size_t N>
+Matrix<M, N, BigInteger> clear_denominators(const Matrix<M, N, Rational> &m,
+                                            BigInteger &scale) {
+  Matrix<M, N, BigInteger> res;
+  for (size_t i = 0; i < M; ++i) {
+    BigInteger row_scale(1);
+    for (size_t j = 0; j < N; ++j) {
+      const BigInteger &denom = m[i][j].getDenominator();
+      row_scale *= denom / BigInteger(gcd(row_scale.abs(), denom.abs()));
     }
-    for (size_t under_row = col + 1; under_row < M; ++under_row) {
-      Field num = tmp[under_row][col] / el;
-      for (size_t i = col; i < M; ++i) {
-        tmp[under_row][i] -= num * tmp[col][i];
-      }
+    for (size_t j = 0; j < N; ++j) {
+      res[i][j] = m[i][j].getNumerator() *
+                  (row_scale / m[i][j].getDenominator());
     }
-    ans *= el;
+    scale *= row_scale;
   }
-  return ans;
+  return res;
 }
 
 template <size_t M, size_t N, typename Field>
-size_t Matrix<M, N, Field>::rank() const {
-  size_t ans = 0;
-  Matrix<M, N, Field> tmp(*this);
-  for (size_t col = 0; col < M; ++col) {
-    size_t max_row = col;
-    for (size_t under_row = col + 1; under_row < M; ++under_row) {
-      if (abs(tmp[under_row][col]) > abs(tmp[col][col])) {
-        max_row = under_row;
-      }
+size_t Matrix<M, N, Field>::bareiss_eliminate(Matrix<M, N, Field> &tmp,
+                                              bool &odd_swaps,
+                                              ThreadPool *pool) {
+  Field prev(1);
+  size_t row = 0;
+  for (size_t col = 0; col < N && row < M; ++col) {
+    size_t pivot = row;
+    while (pivot < M && tmp[pivot][col] == Field(0)) {
+      ++pivot;
     }
-    if (max_row != col) {
-      std::swap(tmp[max_row], tmp[col]);
+    if (pivot == M) {
+      continue;
     }
-    Field el = tmp[col][col];
-    for (size_t under_row = col + 1; under_row < M; ++under_row) {
-      Field num = tmp[under_row][col] / el;
-      for (size_t i = 0; i < M; ++i) {
-        tmp[under_row][i] -= num * tmp[col][i];
-      }
+    if (pivot != row) {
+      odd_swaps = !odd_swaps;
+      std::swap(tmp[pivot], tmp[row]);
     }
-  }
-  for (size_t i = 0; i < M; ++i) {
-    size_t cnt = 0;
-    for (size_t j = 0; j < N; ++j) {
-      if (tmp[i][j] == Field(0)) {
-        ++cnt;
+    for_each_row<Field>(pool, row + 1, M, N - col, [&](size_t under_row) {
+      for (size_t i = col + 1; i < N; ++i) {
+        tmp[under_row][i] *= tmp[row][col];
+        tmp[under_row][i] -= tmp[under_row][col] * tmp[row][i];
+        tmp[under_row][i] /= prev;
       }
-    }
-    if (cnt != N) {
-      ++ans;
-    }
+      tmp[under_row][col] = Field(0);
+    });
+    prev = tmp[row][col];
+    ++row;
   }
-  return ans;
+  return row;
 }
 
 template <size_t M, size_t N, typename Field>
-Matrix<M, N, Field> Matrix<M, N, Field>::inverted() const {
+Field Matrix<M, N, Field>::bareiss_det(ThreadPool *pool) const {
   static_assert(M == N);
-  Matrix<M, 2 * N, Field> tmp;
-  for (size_t i = 0; i < M; ++i) {
-    for (size_t j = 0; j < M; ++j) {
-      tmp[i][j] = data_[i][j];
+  if constexpr (std::is_same_v<Field, Rational>) {
+    BigInteger scale(1);
+    Matrix<M, N, BigInteger> integral = clear_denominators(*this, scale);
+    return Rational(integral.bareiss_det(pool)) / Rational(scale);
+  } else {
+    Matrix<M, N, Field> tmp(*this);
+    bool odd_swaps = false;
+    if (bareiss_eliminate(tmp, odd_swaps, pool) < M) {
+      return Field(0);
     }
-    tmp[i][N + i] = Field(1);
+    return odd_swaps ? -tmp[M - 1][M - 1] : tmp[M - 1][M - 1];
   }
+}
 
-  for (size_t col = 0; col < M; ++col) {
-    Field el = tmp[col][col];
-    for (size_t under_row = col + 1; under_row < M; ++under_row) {
-      Field num = tmp[under_row][col] / el;
-      for (size_t i = col; i < 2 * M; ++i) {
-        tmp[under_row][i] -= num * tmp[col][i];
-      }
-    }
+template <size_t M, size_t N, typename Field>
+size_t Matrix<M, N, Field>::bareiss_rank(ThreadPool *pool) const {
+  if constexpr (std::is_same_v<Field, Rational>) {
+    BigInteger scale(1);
+    return clear_denominators(*this, scale).bareiss_rank(pool);
+  } else {
+    Matrix<M, N, Field> tmp(*this);
+    bool odd_swaps = false;
+    return bareiss_eliminate(tmp, odd_swaps, pool);
   }
-  for (int64_t k = M - 1; k >= 0; --k) {
-    Field el = tmp[k][k];
-    for (int64_t under_row = k - 1; under_row >= 0; --under_row) {
-      Field num = tmp[under_row][k] / el;
-      for (size_t i = k; i < 2 * M; ++i) {
-        tmp[under_row][i] -= num * tmp[k][i];
-      }
-    }
+}
+
+template <size_t M, size_t N, typename Field>
+Field Matrix<M, N, Field>::det(ThreadPool *pool) const {
+  static_assert(M == N);
+  if constexpr (use_bareiss<Field>) {
+    return bareiss_det(pool);
+  } else {
+    return LUDecomposition<M, Field>(*this, pool).det();
   }
-  Matrix<M, N, Field> ans;
-  for (size_t i = 0; i < M; ++i) {
-    for (size_t j = 0; j < N; ++j) {
-      ans[i][j] = tmp[i][N + j] / tmp[i][i];
+}
+
+template <size_t M, size_t N, typename Field>
+size_t Matrix<M, N, Field>::rank(ThreadPool *pool) const {
+  if constexpr (use_bareiss<Field>) {
+    return bareiss_rank(pool);
+  } else if constexpr (M == N) {
+    return LUDecomposition<M, Field>(*this, pool).rank();
+  } else {
+    // Row echelon form: every column with a pivot adds one to the rank.
+    Matrix<M, N, Field> tmp(*this);
+    size_t row = 0;
+    for (size_t col = 0; col < N && row < M; ++col) {
+      size_t pivot = find_pivot(tmp, col, row);
+      if (pivot == M) {
+        continue;
+      }
+      if (pivot != row) {
+        std::swap(tmp[pivot], tmp[row]);
+      }
+      for_each_row<Field>(pool, row + 1, M, N - col, [&](size_t under_row) {
+        if (tmp[under_row][col] == Field(0)) {
+          return;
+        }
+        Field num = tmp[under_row][col] / tmp[row][col];
+        subtract_scaled_row(&tmp[under_row][col + 1], &tmp[row][col + 1], num,
+                            N - col - 1);
+        tmp[under_row][col] = Field(0);
+      });
+      ++row;
     }
+    return row;
   }
-  return ans;
 }
 
 template <size_t M, size_t N, typename Field>
-void Matrix<M, N, Field>::invert() {
-  this->data_ = inverted().data_;
+Matrix<M, N, Field> Matrix<M, N, Field>::inverted(ThreadPool *pool) const {
+  Matrix<M, N, Field> inv(*this);
+  inv.invert(pool);
+  return inv;
+}
+
+// Gauss-Jordan elimination in place: after step col, column col holds the
+// matching column of the inverse of the rows swapped so far, so no augmented
+// copy is needed. The row swaps become column swaps of the result, undone at
+// the end. Throws on a singular matrix, leaving *this unspecified.
+template <size_t M, size_t N, typename Field>
+void Matrix<M, N, Field>::invert(ThreadPool *pool) {
+  static_assert(M == N);
+  std::array<size_t, N> swapped;
+  for (size_t col = 0; col < N; ++col) {
+    size_t pivot = find_pivot(*this, col, col);
+    if (pivot == N) {
+      throw std::invalid_argument("Matrix::invert: matrix is singular");
+    }
+    swapped[col] = pivot;
+    if (pivot != col) {
+      std::swap(data_[pivot], data_[col]);
+    }
+    Field inv = Field(1) / data_[col][col];
+    data_[col][col] = Field(1);
+    for (size_t i = 0; i < N; ++i) {
+      data_[col][i] *= inv;
+    }
+    for_each_row<Field>(pool, 0, N, N, [&](size_t row) {
+      if (row == col || data_[row][col] == Field(0)) {
+        return;
+      }
+      Field num = data_[row][col];
+      data_[row][col] = Field(0);
+      subtract_scaled_row(&data_[row][0], &data_[col][0], num, N);
+    });
+  }
+  for (size_t col = N; col-- > 0;) {
+    if (swapped[col] == col) {
+      continue;
+    }
+    for (size_t row = 0; row < N; ++row) {
+      std::swap(data_[row][col], data_[row][swapped[col]]);
+    }
+  }
 }
 
 template <size_t M, size_t N, typename Field>
@@ -1239,29 +1943,44 @@ const std::array<Field, N> &Matrix<M, N, Field>::operator[](size_t idx) const {
   return data_[idx];
 }
 
-template <size_t M1, size_t N1, size_t M2, size_t N2, typename Field>
-bool operator==(const Matrix<M1, N1, Field> &m1,
-                const Matrix<M2, N2, Field> &m2) {
-  if (M1 != M2 || N1 != N2) {
+template <size_t M, size_t N, typename Field>
+const Field &Matrix<M, N, Field>::entry(size_t i, size_t j) const {
+  return data_[i][j];
+}
+
+template <size_t M, size_t N, typename Field>
+bool Matrix<M, N, Field>::refers_to(const void *m) const {
+  return this == m;
+}
+
+template <size_t M, size_t N, typename Field>
+bool Matrix<M, N, Field>::transposes(const void *) const {
+  return false;
+}
+
+template <typename L, typename R>
+bool operator==(const MatrixExpr<L> &lhs, const MatrixExpr<R> &rhs) {
+  if constexpr (L::rows != R::rows || L::cols != R::cols) {
     return false;
-  }
-  for (size_t i = 0; i < M1; ++i) {
-    for (size_t j = 0; j < N1; ++j) {
-      if (m1[i][j] != m2[i][j]) {
-        return false;
+  } else {
+    for (size_t i = 0; i < L::rows; ++i) {
+      for (size_t j = 0; j < L::cols; ++j) {
+        if (lhs.self().entry(i, j) != rhs.self().entry(i, j)) {
+          return false;
+        }
       }
     }
+    return true;
   }
-  return true;
 }
 
-template <size_t M, size_t N, typename Field>
-std::ostream &operator<<(std::ostream &os, const Matrix<M, N, Field> &m) {
+template <typename Expr>
+std::ostream &operator<<(std::ostream &os, const MatrixExpr<Expr> &expr) {
   os << '{' << '\n';
-  for (size_t i = 0; i < M; ++i) {
+  for (size_t i = 0; i < Expr::rows; ++i) {
     os << '{';
-    for (size_t j = 0; j < N; ++j) {
-      os << m[i][j] << '\t';
+    for (size_t j = 0; j < Expr::cols; ++j) {
+      os << expr.self().entry(i, j) << '\t';
     }
     os << '}' << '\n';
   }
@@ -1281,3 +2000,2398 @@ std::istream &operator>>(std::istream &is, Matrix<M, N, Field> &m) {
 
 template <size_t N, typename Field = Rational>
 using SquareMatrix = Matrix<N, N, Field>;
+
+/*
+================================================================================
+
+                             MATRIX EXPRESSIONS
+
+================================================================================
+*/
+
+template <typename T>
+const bool is_matrix = false;
+
+template <size_t M, size_t N, typename Field>
+const bool is_matrix<Matrix<M, N, Field>> = true;
+
+// Matrices are held by reference, nodes by value: nodes are temporaries of
+// the full expression, matrices outlive it.
+template <typename Expr>
+using ExprOperand = std::conditional_t<is_matrix<Expr>, const Expr &, Expr>;
+
+struct AddOp {
+  template <typename Field>
+  static Field apply(const Field &a, const Field &b) {
+    return a + b;
+  }
+};
+
+struct SubtractOp {
+  template <typename Field>
+  static Field apply(const Field &a, const Field &b) {
+    return a - b;
+  }
+};
+
+template <typename L, typename R, typename Op>
+class MatrixBinary : public MatrixExpr<MatrixBinary<L, R, Op>> {
+ public:
+  using field_type = typename L::field_type;
+  static const size_t rows = L::rows;
+  static const size_t cols = L::cols;
+
+  static_assert(std::is_same_v<field_type, typename R::field_type>);
+  static_assert(L::rows == R::rows && L::cols == R::cols);
+
+  MatrixBinary(const L &lhs, const R &rhs) : lhs_(lhs), rhs_(rhs) {}
+
+  field_type entry(size_t i, size_t j) const {
+    return Op::apply(lhs_.entry(i, j), rhs_.entry(i, j));
+  }
+  bool refers_to(const void *m) const {
+    return lhs_.refers_to(m) || rhs_.refers_to(m);
+  }
+  bool transposes(const void *m) const {
+    return lhs_.transposes(m) || rhs_.transposes(m);
+  }
+
+ private:
+  ExprOperand<L> lhs_;
+  ExprOperand<R> rhs_;
+};
+
+template <typename Expr>
+class MatrixScaled : public MatrixExpr<MatrixScaled<Expr>> {
+ public:
+  using field_type = typename Expr::field_type;
+  static const size_t rows = Expr::rows;
+  static const size_t cols = Expr::cols;
+
+  MatrixScaled(const field_type &factor, const Expr &expr)
+      : factor_(factor), expr_(expr) {}
+
+  field_type entry(size_t i, size_t j) const {
+    return factor_ * expr_.entry(i, j);
+  }
+  bool refers_to(const void *m) const { return expr_.refers_to(m); }
+  bool transposes(const void *m) const { return expr_.transposes(m); }
+
+ private:
+  field_type factor_;
+  ExprOperand<Expr> expr_;
+};
+
+// Zero-copy transpose: entry (i, j) reads entry (j, i) of the operand.
+template <typename Expr>
+class MatrixTransposed : public MatrixExpr<MatrixTransposed<Expr>> {
+ public:
+  using field_type = typename Expr::field_type;
+  static const size_t rows = Expr::cols;
+  static const size_t cols = Expr::rows;
+
+  explicit MatrixTransposed(const Expr &expr) : expr_(expr) {}
+
+  decltype(auto) entry(size_t i, size_t j) const { return expr_.entry(j, i); }
+  bool refers_to(const void *m) const { return expr_.refers_to(m); }
+  bool transposes(const void *m) const { return expr_.refers_to(m); }
+
+ private:
+  ExprOperand<Expr> expr_;
+};
+
+template <typename L, typename R>
+MatrixBinary<L, R, AddOp> operator+(const MatrixExpr<L> &lhs,
+                                    const MatrixExpr<R> &rhs) {
+  return MatrixBinary<L, R, AddOp>(lhs.self(), rhs.self());
+}
+
+template <typename L, typename R>
+MatrixBinary<L, R, SubtractOp> operator-(const MatrixExpr<L> &lhs,
+                                         const MatrixExpr<R> &rhs) {
+  return MatrixBinary<L, R, SubtractOp>(lhs.self(), rhs.self());
+}
+
+template <typename Expr>
+MatrixScaled<Expr> operator*(const MatrixExpr<Expr> &expr,
+                             const typename Expr::field_type &f) {
+  return MatrixScaled<Expr>(f, expr.self());
+}
+
+template <typename Expr>
+MatrixScaled<Expr> operator*(const typename Expr::field_type &f,
+                             const MatrixExpr<Expr> &expr) {
+  return MatrixScaled<Expr>(f, expr.self());
+}
+
+template <typename Expr>
+MatrixTransposed<Expr> transpose(const MatrixExpr<Expr> &expr) {
+  return MatrixTransposed<Expr>(expr.self());
+}
+
+// Nodes hold Matrix operands by reference, including temporaries such as
+// the result of A * B, which die at the end of the full expression. Keep a
+// node only while its matrices live; auto t = transpose(A * B) dangles, so
+// write auto t = eval(transpose(A * B)) or Matrix t = transpose(A * B).
+template <typename Expr>
+Matrix<Expr::rows, Expr::cols, typename Expr::field_type> eval(
+    const MatrixExpr<Expr> &expr) {
+  return Matrix<Expr::rows, Expr::cols, typename Expr::field_type>(expr);
+}
+
+// Products are not lazy: an expression operand is evaluated into a Matrix
+// and the product goes through the blocked kernel, so (A + B) * C and
+// f * A * B read like they do on matrices. Matrix * Matrix itself takes the
+// exact overload above.
+template <typename L, size_t N, size_t K, typename Field>
+Matrix<L::rows, K, Field> operator*(const MatrixExpr<L> &lhs,
+                                    const Matrix<N, K, Field> &rhs) {
+  return eval(lhs) * rhs;
+}
+
+template <size_t M, size_t N, typename R, typename Field>
+Matrix<M, R::cols, Field> operator*(const Matrix<M, N, Field> &lhs,
+                                    const MatrixExpr<R> &rhs) {
+  return lhs * eval(rhs);
+}
+
+template <typename L, typename R>
+Matrix<L::rows, R::cols, typename L::field_type> operator*(
+    const MatrixExpr<L> &lhs, const MatrixExpr<R> &rhs) {
+  return eval(lhs) * eval(rhs);
+}
+
+template <typename Expr>
+auto MatrixExpr<Expr>::det(ThreadPool *pool) const {
+  return eval(*this).det(pool);
+}
+
+template <typename Expr>
+auto MatrixExpr<Expr>::rank(ThreadPool *pool) const {
+  return eval(*this).rank(pool);
+}
+
+template <typename Expr>
+auto MatrixExpr<Expr>::inverted(ThreadPool *pool) const {
+  return eval(*this).inverted(pool);
+}
+
+template <typename Expr>
+auto MatrixExpr<Expr>::transposed() const {
+  return eval(*this).transposed();
+}
+
+template <typename Expr>
+auto MatrixExpr<Expr>::trace() const {
+  return eval(*this).trace();
+}
+
+/*
+================================================================================
+
+                                MATRIX VIEWS
+
+================================================================================
+*/
+
+// Non-owning strided view of a row or column; T is Field or const Field.
+// Elements are reached by index, so a column iterator never steps past the
+// end of the matrix storage.
+template <typename T>
+class VectorView {
+ public:
+  using value_type = std::remove_const_t<T>;
+
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::remove_const_t<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
+    iterator(T *data, size_t stride, size_t idx)
+        : data_(data), stride_(stride), idx_(idx) {}
+
+    T &operator*() const { return data_[idx_ * stride_]; }
+    T *operator->() const { return data_ + idx_ * stride_; }
+    iterator &operator++() {
+      ++idx_;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator old = *this;
+      ++idx_;
+      return old;
+    }
+    bool operator==(const iterator &other) const { return idx_ == other.idx_; }
+    bool operator!=(const iterator &other) const { return idx_ != other.idx_; }
+
+   private:
+    T *data_;
+    size_t stride_;
+    size_t idx_;
+  };
+
+  VectorView(T *data, size_t size, size_t stride = 1)
+      : data_(data), size_(size), stride_(stride) {}
+
+  template <typename U,
+            typename = std::enable_if_t<std::is_same_v<const U, T> &&
+                                        !std::is_same_v<U, T>>>
+  VectorView(const VectorView<U> &other)
+      : data_(other.data()), size_(other.size()), stride_(other.stride()) {}
+
+  size_t size() const { return size_; }
+  size_t stride() const { return stride_; }
+  T *data() const { return data_; }
+  T &operator[](size_t idx) const { return data_[idx * stride_]; }
+  iterator begin() const { return iterator(data_, stride_, 0); }
+  iterator end() const { return iterator(data_, stride_, size_); }
+
+  template <typename U>
+  const VectorView &operator+=(const VectorView<U> &other) const;
+  template <typename U>
+  const VectorView &operator-=(const VectorView<U> &other) const;
+  const VectorView &operator*=(const value_type &f) const;
+
+ private:
+  T *data_;
+  size_t size_;
+  size_t stride_;
+};
+
+template <typename T>
+using RowView = VectorView<T>;
+
+template <typename T>
+using ColumnView = VectorView<T>;
+
+template <typename T>
+template <typename U>
+const VectorView<T> &VectorView<T>::operator+=(const VectorView<U> &other) const {
+  for (size_t i = 0; i < size_; ++i) {
+    (*this)[i] += other[i];
+  }
+  return *this;
+}
+
+template <typename T>
+template <typename U>
+const VectorView<T> &VectorView<T>::operator-=(const VectorView<U> &other) const {
+  for (size_t i = 0; i < size_; ++i) {
+    (*this)[i] -= other[i];
+  }
+  return *this;
+}
+
+template <typename T>
+const VectorView<T> &VectorView<T>::operator*=(const value_type &f) const {
+  for (size_t i = 0; i < size_; ++i) {
+    (*this)[i] *= f;
+  }
+  return *this;
+}
+
+template <typename T, typename U>
+std::remove_const_t<T> dot(const VectorView<T> &a, const VectorView<U> &b) {
+  std::remove_const_t<T> res(0);
+  for (size_t i = 0; i < a.size(); ++i) {
+    res += a[i] * b[i];
+  }
+  return res;
+}
+
+// dst -= num * src; contiguous views go through the row kernels.
+template <typename T, typename U>
+void subtract_scaled(const VectorView<T> &dst, const VectorView<U> &src,
+                     const T &num) {
+  if (dst.stride() == 1 && src.stride() == 1) {
+    subtract_scaled_row(dst.data(), src.data(), num, dst.size());
+    return;
+  }
+  for (size_t i = 0; i < dst.size(); ++i) {
+    dst[i] -= num * src[i];
+  }
+}
+
+// Non-owning R x C block of a matrix with row stride stride. It reads like
+// a Matrix in expressions, and assigning an expression writes through to
+// the parent.
+template <size_t R, size_t C, typename T>
+class MatrixView : public MatrixExpr<MatrixView<R, C, T>> {
+ public:
+  using field_type = std::remove_const_t<T>;
+  static const size_t rows = R;
+  static const size_t cols = C;
+
+  MatrixView(T *origin, size_t stride, const void *parent)
+      : origin_(origin), stride_(stride), parent_(parent) {}
+  MatrixView(const MatrixView &other) = default;
+
+  MatrixView &operator=(const MatrixView &other);
+  template <typename Expr>
+  MatrixView &operator=(const MatrixExpr<Expr> &expr);
+
+  VectorView<T> operator[](size_t idx) const { return row(idx); }
+  VectorView<T> row(size_t idx) const {
+    return VectorView<T>(origin_ + idx * stride_, C);
+  }
+  VectorView<T> column(size_t idx) const {
+    return VectorView<T>(origin_ + idx, R, stride_);
+  }
+  template <size_t R2, size_t C2>
+  MatrixView<R2, C2, T> submatrix(size_t first_row, size_t first_col) const;
+
+  const field_type &entry(size_t i, size_t j) const {
+    return origin_[i * stride_ + j];
+  }
+  bool refers_to(const void *m) const { return parent_ == m; }
+  bool transposes(const void *) const { return false; }
+
+ private:
+  T *origin_;
+  size_t stride_;
+  const void *parent_;
+};
+
+template <size_t R, size_t C, typename T>
+MatrixView<R, C, T> &MatrixView<R, C, T>::operator=(const MatrixView &other) {
+  return *this = static_cast<const MatrixExpr<MatrixView> &>(other);
+}
+
+// Blocks of the same parent may overlap, so such expressions go through a
+// temporary.
+template <size_t R, size_t C, typename T>
+template <typename Expr>
+MatrixView<R, C, T> &MatrixView<R, C, T>::operator=(
+    const MatrixExpr<Expr> &expr) {
+  static_assert(!std::is_const_v<T>, "assignment to a const view");
+  static_assert(Expr::rows == R && Expr::cols == C);
+  if (expr.self().refers_to(parent_)) {
+    return *this = Matrix<R, C, field_type>(expr);
+  }
+  for (size_t i = 0; i < R; ++i) {
+    for (size_t j = 0; j < C; ++j) {
+      origin_[i * stride_ + j] = expr.self().entry(i, j);
+    }
+  }
+  return *this;
+}
+
+template <size_t R, size_t C, typename T>
+template <size_t R2, size_t C2>
+MatrixView<R2, C2, T> MatrixView<R, C, T>::submatrix(size_t first_row,
+                                                     size_t first_col) const {
+  return MatrixView<R2, C2, T>(origin_ + first_row * stride_ + first_col,
+                               stride_, parent_);
+}
+
+// res += a * b on blocks, one row kernel call per nonzero entry of a.
+template <size_t R, size_t K, size_t C, typename T, typename U, typename Field>
+void multiply_add_into(const MatrixView<R, K, T> &a,
+                       const MatrixView<K, C, U> &b,
+                       const MatrixView<R, C, Field> &res) {
+  for (size_t i = 0; i < R; ++i) {
+    for (size_t k = 0; k < K; ++k) {
+      if (a.entry(i, k) == Field(0)) {
+        continue;
+      }
+      subtract_scaled(res.row(i), b.row(k), Field(0) - a.entry(i, k));
+    }
+  }
+}
+
+template <size_t M, size_t N, typename Field>
+VectorView<Field> Matrix<M, N, Field>::row(size_t idx) {
+  return VectorView<Field>(data_[idx].data(), N);
+}
+
+template <size_t M, size_t N, typename Field>
+VectorView<const Field> Matrix<M, N, Field>::row(size_t idx) const {
+  return VectorView<const Field>(data_[idx].data(), N);
+}
+
+template <size_t M, size_t N, typename Field>
+VectorView<Field> Matrix<M, N, Field>::column(size_t idx) {
+  static_assert(sizeof(data_) == M * N * sizeof(Field));
+  return VectorView<Field>(&data_[0][idx], M, N);
+}
+
+template <size_t M, size_t N, typename Field>
+VectorView<const Field> Matrix<M, N, Field>::column(size_t idx) const {
+  static_assert(sizeof(data_) == M * N * sizeof(Field));
+  return VectorView<const Field>(&data_[0][idx], M, N);
+}
+
+template <size_t M, size_t N, typename Field>
+template <size_t R, size_t C>
+MatrixView<R, C, Field> Matrix<M, N, Field>::submatrix(size_t first_row,
+                                                       size_t first_col) {
+  static_assert(R <= M && C <= N);
+  return MatrixView<R, C, Field>(&data_[first_row][first_col], N, this);
+}
+
+template <size_t M, size_t N, typename Field>
+template <size_t R, size_t C>
+MatrixView<R, C, const Field> Matrix<M, N, Field>::submatrix(
+    size_t first_row, size_t first_col) const {
+  static_assert(R <= M && C <= N);
+  return MatrixView<R, C, const Field>(&data_[first_row][first_col], N, this);
+}
+
+/*
+================================================================================
+
+                           POWERS AND RECURRENCES
+
+================================================================================
+*/
+
+// m^power by binary exponentiation. Products are written into the spare
+// buffer of each pair and the pointers swapped, so no matrix is copied or
+// allocated inside the loop.
+template <size_t N, typename Field>
+Matrix<N, N, Field> pow(const Matrix<N, N, Field> &m, uint64_t power) {
+  Matrix<N, N, Field> res_buffers[2];
+  Matrix<N, N, Field> base_buffers[2] = {m, m};
+  Matrix<N, N, Field> *res = &res_buffers[0];
+  Matrix<N, N, Field> *res_spare = &res_buffers[1];
+  Matrix<N, N, Field> *base = &base_buffers[0];
+  Matrix<N, N, Field> *base_spare = &base_buffers[1];
+  for (size_t i = 0; i < N; ++i) {
+    (*res)[i][i] = Field(1);
+  }
+  while (power > 0) {
+    if (power & 1) {
+      multiply_into(*res, *base, *res_spare);
+      std::swap(res, res_spare);
+    }
+    power >>= 1;
+    if (power > 0) {
+      multiply_into(*base, *base, *base_spare);
+      std::swap(base, base_spare);
+    }
+  }
+  return *res;
+}
+
+// Reduces poly modulo x^k - coeffs[0] x^(k-1) - ... - coeffs[k-1] in place,
+// leaving k coefficients.
+template <typename Field>
+void reduce_by_recurrence(std::vector<Field> &poly,
+                          const std::vector<Field> &coeffs) {
+  size_t k = coeffs.size();
+  for (size_t deg = poly.size(); deg-- > k;) {
+    if (poly[deg] == Field(0)) {
+      continue;
+    }
+    for (size_t j = 1; j <= k; ++j) {
+      poly[deg - j] += poly[deg] * coeffs[j - 1];
+    }
+  }
+  poly.resize(k, Field(0));
+}
+
+template <typename Field>
+std::vector<Field> multiply_by_recurrence(const std::vector<Field> &a,
+                                          const std::vector<Field> &b,
+                                          const std::vector<Field> &coeffs) {
+  std::vector<Field> prod(a.size() + b.size() - 1, Field(0));
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i] == Field(0)) {
+      continue;
+    }
+    for (size_t j = 0; j < b.size(); ++j) {
+      prod[i + j] += a[i] * b[j];
+    }
+  }
+  reduce_by_recurrence(prod, coeffs);
+  return prod;
+}
+
+// x^n reduced modulo the characteristic polynomial of the recurrence.
+template <typename Field>
+std::vector<Field> power_by_recurrence(const std::vector<Field> &coeffs,
+                                       uint64_t n) {
+  std::vector<Field> res(1, Field(1));
+  std::vector<Field> base = {Field(0), Field(1)};
+  reduce_by_recurrence(res, coeffs);
+  reduce_by_recurrence(base, coeffs);
+  while (n > 0) {
+    if (n & 1) {
+      res = multiply_by_recurrence(res, base, coeffs);
+    }
+    n >>= 1;
+    if (n > 0) {
+      base = multiply_by_recurrence(base, base, coeffs);
+    }
+  }
+  return res;
+}
+
+// Kitamasa's method: the n-th term of
+// a_i = coeffs[0] * a_(i-1) + ... + coeffs[k-1] * a_(i-k), given a_0 .. a_(k-1)
+// in init. x^n is reduced modulo the characteristic polynomial by binary
+// exponentiation, so the cost is O(k^2 log n) instead of the O(k^3 log n) of
+// pow() on the companion matrix.
+template <typename Field>
+Field linear_recurrence(const std::vector<Field> &coeffs,
+                        const std::vector<Field> &init, uint64_t n) {
+  size_t k = coeffs.size();
+  if (init.size() != k) {
+    throw std::invalid_argument("linear_recurrence: init.size() != order");
+  }
+  if (k == 0) {
+    return Field(0);
+  }
+  if (n < k) {
+    return init[n];
+  }
+  std::vector<Field> res = power_by_recurrence(coeffs, n);
+  Field term(0);
+  for (size_t i = 0; i < k; ++i) {
+    term += res[i] * init[i];
+  }
+  return term;
+}
+
+/*
+================================================================================
+
+                          CHARACTERISTIC POLYNOMIAL
+
+================================================================================
+*/
+
+// Polynomials are coefficient vectors, lowest degree first.
+
+// Reduces m to upper Hessenberg form by similarity transforms: each row
+// operation below the subdiagonal is paired with the inverse column
+// operation, so the characteristic polynomial is unchanged.
+template <size_t N, typename Field>
+Matrix<N, N, Field> hessenberg(const Matrix<N, N, Field> &m) {
+  Matrix<N, N, Field> h = m;
+  for (size_t col = 0; col + 2 < N; ++col) {
+    size_t pivot = find_pivot(h, col, col + 1);
+    if (pivot == N) {
+      continue;
+    }
+    if (pivot != col + 1) {
+      std::swap(h[pivot], h[col + 1]);
+      for (size_t i = 0; i < N; ++i) {
+        std::swap(h[i][pivot], h[i][col + 1]);
+      }
+    }
+    for (size_t row = col + 2; row < N; ++row) {
+      if (h[row][col] == Field(0)) {
+        continue;
+      }
+      Field num = h[row][col] / h[col + 1][col];
+      h[row][col] = Field(0);
+      subtract_scaled_row(&h[row][col + 1], &h[col + 1][col + 1], num,
+                          N - col - 1);
+      for (size_t i = 0; i < N; ++i) {
+        h[i][col + 1] += num * h[i][row];
+      }
+    }
+  }
+  return h;
+}
+
+// det(xI - m), monic of degree N, in O(N^3): Hessenberg reduction followed
+// by the recurrence over the leading principal minors of xI - h.
+template <size_t N, typename Field>
+std::vector<Field> charpoly(const Matrix<N, N, Field> &m) {
+  Matrix<N, N, Field> h = hessenberg(m);
+  std::vector<std::vector<Field>> minors(N + 1);
+  minors[0] = {Field(1)};
+  for (size_t k = 1; k <= N; ++k) {
+    std::vector<Field> &cur = minors[k];
+    const std::vector<Field> &prev = minors[k - 1];
+    cur.assign(k + 1, Field(0));
+    for (size_t i = 0; i < k; ++i) {
+      cur[i + 1] += prev[i];
+      cur[i] -= h[k - 1][k - 1] * prev[i];
+    }
+    Field sub(1);
+    for (size_t i = 1; i < k; ++i) {
+      sub *= h[k - i][k - i - 1];
+      if (sub == Field(0)) {
+        break;
+      }
+      Field num = sub * h[k - i - 1][k - 1];
+      const std::vector<Field> &lower = minors[k - i - 1];
+      for (size_t j = 0; j < lower.size(); ++j) {
+        cur[j] -= num * lower[j];
+      }
+    }
+  }
+  return minors[N];
+}
+
+template <size_t N, typename Field>
+std::vector<Field> apply_matrix(const Matrix<N, N, Field> &m,
+                                const std::vector<Field> &v) {
+  std::vector<Field> res(N, Field(0));
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      res[i] += m[i][j] * v[j];
+    }
+  }
+  return res;
+}
+
+// Minimal polynomial of v under m: the Krylov vectors v, mv, m^2 v, ... are
+// reduced against each other until one becomes dependent; the combination
+// that cancels it is the polynomial.
+template <size_t N, typename Field>
+std::vector<Field> vector_minpoly(const Matrix<N, N, Field> &m,
+                                  const std::vector<Field> &v) {
+  std::vector<std::vector<Field>> basis;
+  std::vector<std::vector<Field>> combos;
+  std::vector<size_t> pivots;
+  std::vector<Field> krylov = v;
+  for (size_t deg = 0;; ++deg) {
+    std::vector<Field> cur = krylov;
+    std::vector<Field> combo(deg + 1, Field(0));
+    combo[deg] = Field(1);
+    for (size_t b = 0; b < basis.size(); ++b) {
+      if (cur[pivots[b]] == Field(0)) {
+        continue;
+      }
+      Field num = cur[pivots[b]] / basis[b][pivots[b]];
+      subtract_scaled_row(cur.data(), basis[b].data(), num, N);
+      subtract_scaled_row(combo.data(), combos[b].data(), num,
+                          combos[b].size());
+    }
+    size_t pivot = 0;
+    while (pivot < N && cur[pivot] == Field(0)) {
+      ++pivot;
+    }
+    if (pivot == N) {
+      return combo;
+    }
+    basis.push_back(std::move(cur));
+    combos.push_back(std::move(combo));
+    pivots.push_back(pivot);
+    krylov = apply_matrix(m, krylov);
+  }
+}
+
+template <typename Field>
+std::vector<Field> multiply_polynomials(const std::vector<Field> &a,
+                                        const std::vector<Field> &b) {
+  std::vector<Field> prod(a.size() + b.size() - 1, Field(0));
+  for (size_t i = 0; i < a.size(); ++i) {
+    for (size_t j = 0; j < b.size(); ++j) {
+      prod[i + j] += a[i] * b[j];
+    }
+  }
+  return prod;
+}
+
+// Reduces a modulo b in place and returns the quotient. b must not end in
+// a zero coefficient; a loses its trailing zeros.
+template <typename Field>
+std::vector<Field> divide_polynomials(std::vector<Field> &a,
+                                      const std::vector<Field> &b) {
+  while (!a.empty() && a.back() == Field(0)) {
+    a.pop_back();
+  }
+  if (a.size() < b.size()) {
+    return {};
+  }
+  std::vector<Field> quotient(a.size() - b.size() + 1, Field(0));
+  while (a.size() >= b.size()) {
+    size_t shift = a.size() - b.size();
+    Field num = a.back() / b.back();
+    quotient[shift] = num;
+    for (size_t i = 0; i + 1 < b.size(); ++i) {
+      a[shift + i] -= num * b[i];
+    }
+    a.pop_back();
+    while (!a.empty() && a.back() == Field(0)) {
+      a.pop_back();
+    }
+  }
+  return quotient;
+}
+
+// Product of the distinct irreducible factors of the monic poly, each once:
+// poly / gcd(poly, poly'), made monic. A factor whose exponent is a multiple
+// of the characteristic is lost, so in general this only divides the true
+// radical.
+template <typename Field>
+std::vector<Field> squarefree_part(const std::vector<Field> &poly) {
+  std::vector<Field> a = poly;
+  std::vector<Field> b;
+  for (size_t i = 1; i < poly.size(); ++i) {
+    b.push_back(Field(static_cast<int>(i)) * poly[i]);
+  }
+  while (!b.empty() && b.back() == Field(0)) {
+    b.pop_back();
+  }
+  while (!b.empty()) {
+    divide_polynomials(a, b);
+    std::swap(a, b);
+  }
+  std::vector<Field> rest = poly;
+  std::vector<Field> res = divide_polynomials(rest, a);
+  Field lead = res.back();
+  for (Field &c : res) {
+    c /= lead;
+  }
+  return res;
+}
+
+// Monic minimal polynomial, derived from charpoly(m). Every irreducible
+// factor of charpoly divides the minimal polynomial, so it starts from the
+// squarefree part of charpoly; when charpoly is squarefree, the usual case,
+// that already has degree N and is the answer. Splitting a repeated factor
+// further would need polynomial factorization over Field, which this file
+// has no way to do for Rational, so the missing powers are recovered from
+// the unit vectors instead: if p annihilates the vectors seen so far, then
+// lcm(p, minpoly(e)) = p * minpoly(p(m) e). Once the degree reaches N, no
+// unit vector can raise it and the loop stops. Floating point fields skip
+// the gcd, whose exact zero tests rounding would defeat.
+template <size_t N, typename Field>
+std::vector<Field> minpoly(const Matrix<N, N, Field> &m) {
+  std::vector<Field> res = {Field(1)};
+  if constexpr (!std::is_floating_point_v<Field>) {
+    res = squarefree_part(charpoly(m));
+  }
+  for (size_t j = 0; j < N && res.size() <= N; ++j) {
+    std::vector<Field> w(N, Field(0));
+    for (size_t i = res.size(); i-- > 0;) {
+      w = apply_matrix(m, w);
+      w[j] += res[i];
+    }
+    bool zero = true;
+    for (size_t i = 0; zero && i < N; ++i) {
+      zero = (w[i] == Field(0));
+    }
+    if (!zero) {
+      res = multiply_polynomials(res, vector_minpoly(m, w));
+    }
+  }
+  return res;
+}
+
+// m^power through Cayley-Hamilton: x^power is reduced modulo charpoly(m)
+// with the Kitamasa machinery, and the remainder of degree < N is evaluated
+// by Paterson-Stockmeyer, which takes about 2 sqrt(N) matrix products
+// instead of the 2 log(power) of pow().
+template <size_t N, typename Field>
+Matrix<N, N, Field> pow_by_charpoly(const Matrix<N, N, Field> &m,
+                                    uint64_t power) {
+  std::vector<Field> poly = charpoly(m);
+  std::vector<Field> coeffs(N);
+  for (size_t j = 1; j <= N; ++j) {
+    coeffs[j - 1] = Field(0) - poly[N - j];
+  }
+  std::vector<Field> rem = power_by_recurrence(coeffs, power);
+  size_t step = 1;
+  while (step * step < N) {
+    ++step;
+  }
+  std::vector<Matrix<N, N, Field>> powers(step + 1);
+  for (size_t i = 0; i < N; ++i) {
+    powers[0][i][i] = Field(1);
+  }
+  for (size_t i = 1; i <= step; ++i) {
+    multiply_into(powers[i - 1], m, powers[i]);
+  }
+  Matrix<N, N, Field> res;
+  Matrix<N, N, Field> spare;
+  for (size_t block = (N + step - 1) / step; block-- > 0;) {
+    multiply_into(res, powers[step], spare);
+    for (size_t i = 0; i < step && block * step + i < N; ++i) {
+      const Field &c = rem[block * step + i];
+      if (c == Field(0)) {
+        continue;
+      }
+      for (size_t r = 0; r < N; ++r) {
+        for (size_t col = 0; col < N; ++col) {
+          spare[r][col] += c * powers[i][r][col];
+        }
+      }
+    }
+    std::swap(res, spare);
+  }
+  return res;
+}
+
+// trace(m^power). The traces of m^0 .. m^(N-1) come from charpoly by Newton's
+// identities, which need no division, and the later ones obey the
+// recurrence given by charpoly.
+template <size_t N, typename Field>
+Field trace_of_power(const Matrix<N, N, Field> &m, uint64_t power) {
+  std::vector<Field> poly = charpoly(m);
+  std::vector<Field> coeffs(N);
+  for (size_t j = 1; j <= N; ++j) {
+    coeffs[j - 1] = Field(0) - poly[N - j];
+  }
+  std::vector<Field> traces(N);
+  if (N > 0) {
+    traces[0] = Field(static_cast<int>(N));
+  }
+  for (size_t k = 1; k < N; ++k) {
+    traces[k] = Field(static_cast<int>(k)) * coeffs[k - 1];
+    for (size_t j = 1; j < k; ++j) {
+      traces[k] += coeffs[j - 1] * traces[k - j];
+    }
+  }
+  return linear_recurrence(coeffs, traces, power);
+}
+
+/*
+================================================================================
+
+                              LU DECOMPOSITION
+
+================================================================================
+*/
+
+// PA = LU with partial pivoting, stored in place: U on and above the
+// diagonal, the unit lower L below it. Singular matrices are reduced to row
+// echelon form instead, which is enough for det() and rank(); solve() and
+// inverse() need a nonsingular matrix.
+template <size_t N, typename Field>
+class LUDecomposition {
+ public:
+  LUDecomposition(const Matrix<N, N, Field> &m, ThreadPool *pool = nullptr);
+
+  bool isSingular() const;
+  size_t rank() const;
+  Field det() const;
+  std::array<Field, N> solve(const std::array<Field, N> &b) const;
+  template <size_t K>
+  Matrix<N, K, Field> solve(const Matrix<N, K, Field> &b) const;
+  Matrix<N, N, Field> inverse() const;
+
+ private:
+  void factorize(ThreadPool *pool);
+  void check_singular() const;
+
+  Matrix<N, N, Field> lu_;
+  std::array<size_t, N> perm_;
+  bool odd_swaps_;
+  size_t rank_;
+};
+
+template <size_t N, typename Field>
+LUDecomposition<N, Field>::LUDecomposition(const Matrix<N, N, Field> &m,
+                                           ThreadPool *pool)
+    : lu_(m), odd_swaps_(false), rank_(0) {
+  for (size_t i = 0; i < N; ++i) {
+    perm_[i] = i;
+  }
+  factorize(pool);
+}
+
+template <size_t N, typename Field>
+void LUDecomposition<N, Field>::factorize(ThreadPool *pool) {
+  for (size_t col = 0; col < N && rank_ < N; ++col) {
+    size_t row = rank_;
+    size_t pivot = find_pivot(lu_, col, row);
+    if (pivot == N) {
+      continue;
+    }
+    if (pivot != row) {
+      odd_swaps_ = !odd_swaps_;
+      std::swap(lu_[pivot], lu_[row]);
+      std::swap(perm_[pivot], perm_[row]);
+    }
+    for_each_row<Field>(pool, row + 1, N, N - col, [&](size_t under_row) {
+      if (lu_[under_row][col] == Field(0)) {
+        return;
+      }
+      Field num = lu_[under_row][col] / lu_[row][col];
+      subtract_scaled_row(&lu_[under_row][col + 1], &lu_[row][col + 1], num,
+                          N - col - 1);
+      lu_[under_row][col] = num;
+    });
+    ++rank_;
+  }
+}
+
+template <size_t N, typename Field>
+bool LUDecomposition<N, Field>::isSingular() const {
+  return rank_ < N;
+}
+
+template <size_t N, typename Field>
+size_t LUDecomposition<N, Field>::rank() const {
+  return rank_;
+}
+
+template <size_t N, typename Field>
+Field LUDecomposition<N, Field>::det() const {
+  if (isSingular()) {
+    return Field(0);
+  }
+  Field ans(1);
+  for (size_t i = 0; i < N; ++i) {
+    ans *= lu_[i][i];
+  }
+  return odd_swaps_ ? Field(0) - ans : ans;
+}
+
+template <size_t N, typename Field>
+std::array<Field, N> LUDecomposition<N, Field>::solve(
+    const std::array<Field, N> &b) const {
+  check_singular();
+  std::array<Field, N> x;
+  for (size_t i = 0; i < N; ++i) {
+    x[i] = b[perm_[i]];
+    for (size_t j = 0; j < i; ++j) {
+      x[i] -= lu_[i][j] * x[j];
+    }
+  }
+  for (size_t i = N; i-- > 0;) {
+    for (size_t j = i + 1; j < N; ++j) {
+      x[i] -= lu_[i][j] * x[j];
+    }
+    x[i] /= lu_[i][i];
+  }
+  return x;
+}
+
+template <size_t N, typename Field>
+template <size_t K>
+Matrix<N, K, Field> LUDecomposition<N, Field>::solve(
+    const Matrix<N, K, Field> &b) const {
+  check_singular();
+  Matrix<N, K, Field> x;
+  for (size_t i = 0; i < N; ++i) {
+    x[i] = b[perm_[i]];
+    for (size_t j = 0; j < i; ++j) {
+      for (size_t k = 0; k < K; ++k) {
+        x[i][k] -= lu_[i][j] * x[j][k];
+      }
+    }
+  }
+  for (size_t i = N; i-- > 0;) {
+    for (size_t j = i + 1; j < N; ++j) {
+      for (size_t k = 0; k < K; ++k) {
+        x[i][k] -= lu_[i][j] * x[j][k];
+      }
+    }
+    for (size_t k = 0; k < K; ++k) {
+      x[i][k] /= lu_[i][i];
+    }
+  }
+  return x;
+}
+
+template <size_t N, typename Field>
+Matrix<N, N, Field> LUDecomposition<N, Field>::inverse() const {
+  Matrix<N, N, Field> id;
+  for (size_t i = 0; i < N; ++i) {
+    id[i][i] = Field(1);
+  }
+  return solve(id);
+}
+
+template <size_t N, typename Field>
+void LUDecomposition<N, Field>::check_singular() const {
+  if (isSingular()) {
+    throw std::invalid_argument("LUDecomposition: matrix is singular");
+  }
+}
+
+/*
+================================================================================
+
+                                SPARSE MATRIX
+
+================================================================================
+*/
+
+// Compressed sparse row storage with runtime shape: row i owns the entries
+// [row_start_[i], row_start_[i + 1]) of col_idx_ and values_, sorted by
+// column. transposed() gives the CSR form of the transpose, i.e. the CSC
+// form of *this.
+template <typename Field = Rational>
+class SparseMatrix {
+ public:
+  using Entry = std::tuple<size_t, size_t, Field>;
+
+  SparseMatrix(size_t rows, size_t cols);
+  SparseMatrix(size_t rows, size_t cols, std::vector<Entry> entries);
+  template <size_t M, size_t N>
+  explicit SparseMatrix(const Matrix<M, N, Field> &m);
+
+  size_t rows() const;
+  size_t cols() const;
+  size_t nonZeros() const;
+  Field at(size_t row, size_t col) const;
+
+  SparseMatrix<Field> transposed() const;
+  template <size_t M, size_t N>
+  Matrix<M, N, Field> toDense() const;
+
+  std::vector<Field> apply(const std::vector<Field> &x) const;
+  std::vector<Field> applyTransposed(const std::vector<Field> &x) const;
+
+  template <typename F>
+  friend SparseMatrix<F> operator*(const SparseMatrix<F> &a,
+                                   const SparseMatrix<F> &b);
+  template <size_t M, size_t N, size_t K, typename F>
+  friend void multiply_into(const SparseMatrix<F> &a,
+                            const Matrix<N, K, F> &b, Matrix<M, K, F> &res);
+
+ private:
+  size_t rows_;
+  size_t cols_;
+  std::vector<size_t> row_start_;
+  std::vector<size_t> col_idx_;
+  std::vector<Field> values_;
+};
+
+template <typename Field>
+SparseMatrix<Field>::SparseMatrix(size_t rows, size_t cols)
+    : rows_(rows), cols_(cols), row_start_(rows + 1, 0) {}
+
+// Duplicate (row, col) entries are summed, explicit zeros dropped.
+template <typename Field>
+SparseMatrix<Field>::SparseMatrix(size_t rows, size_t cols,
+                                  std::vector<Entry> entries)
+    : rows_(rows), cols_(cols), row_start_(rows + 1, 0) {
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &e1, const Entry &e2) {
+              return std::tie(std::get<0>(e1), std::get<1>(e1)) <
+                     std::tie(std::get<0>(e2), std::get<1>(e2));
+            });
+  for (size_t i = 0; i < entries.size();) {
+    auto [row, col, value] = entries[i];
+    if (row >= rows_ || col >= cols_) {
+      throw std::out_of_range("SparseMatrix: entry out of range");
+    }
+    for (++i; i < entries.size() && std::get<0>(entries[i]) == row &&
+              std::get<1>(entries[i]) == col;
+         ++i) {
+      value += std::get<2>(entries[i]);
+    }
+    if (value == Field(0)) {
+      continue;
+    }
+    col_idx_.push_back(col);
+    values_.push_back(value);
+    ++row_start_[row + 1];
+  }
+  for (size_t i = 0; i < rows_; ++i) {
+    row_start_[i + 1] += row_start_[i];
+  }
+}
+
+template <typename Field>
+template <size_t M, size_t N>
+SparseMatrix<Field>::SparseMatrix(const Matrix<M, N, Field> &m)
+    : rows_(M), cols_(N), row_start_(M + 1, 0) {
+  for (size_t i = 0; i < M; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      if (m[i][j] != Field(0)) {
+        col_idx_.push_back(j);
+        values_.push_back(m[i][j]);
+      }
+    }
+    row_start_[i + 1] = values_.size();
+  }
+}
+
+template <typename Field>
+size_t SparseMatrix<Field>::rows() const {
+  return rows_;
+}
+
+template <typename Field>
+size_t SparseMatrix<Field>::cols() const {
+  return cols_;
+}
+
+template <typename Field>
+size_t SparseMatrix<Field>::nonZeros() const {
+  return values_.size();
+}
+
+template <typename Field>
+Field SparseMatrix<Field>::at(size_t row, size_t col) const {
+  auto first = col_idx_.begin() + row_start_[row];
+  auto last = col_idx_.begin() + row_start_[row + 1];
+  auto it = std::lower_bound(first, last, col);
+  if (it == last || *it != col) {
+    return Field(0);
+  }
+  return values_[it - col_idx_.begin()];
+}
+
+template <typename Field>
+SparseMatrix<Field> SparseMatrix<Field>::transposed() const {
+  SparseMatrix<Field> t(cols_, rows_);
+  for (size_t col : col_idx_) {
+    ++t.row_start_[col + 1];
+  }
+  for (size_t i = 0; i < cols_; ++i) {
+    t.row_start_[i + 1] += t.row_start_[i];
+  }
+  t.col_idx_.resize(values_.size());
+  t.values_.resize(values_.size(), Field(0));
+  std::vector<size_t> fill(t.row_start_.begin(), t.row_start_.end() - 1);
+  for (size_t row = 0; row < rows_; ++row) {
+    for (size_t k = row_start_[row]; k < row_start_[row + 1]; ++k) {
+      size_t pos = fill[col_idx_[k]]++;
+      t.col_idx_[pos] = row;
+      t.values_[pos] = values_[k];
+    }
+  }
+  return t;
+}
+
+template <typename Field>
+template <size_t M, size_t N>
+Matrix<M, N, Field> SparseMatrix<Field>::toDense() const {
+  if (rows_ != M || cols_ != N) {
+    throw std::invalid_argument("SparseMatrix::toDense: shape mismatch");
+  }
+  Matrix<M, N, Field> res;
+  for (size_t row = 0; row < rows_; ++row) {
+    for (size_t k = row_start_[row]; k < row_start_[row + 1]; ++k) {
+      res[row][col_idx_[k]] = values_[k];
+    }
+  }
+  return res;
+}
+
+template <typename Field>
+std::vector<Field> SparseMatrix<Field>::apply(
+    const std::vector<Field> &x) const {
+  std::vector<Field> y(rows_, Field(0));
+  for (size_t row = 0; row < rows_; ++row) {
+    for (size_t k = row_start_[row]; k < row_start_[row + 1]; ++k) {
+      y[row] += values_[k] * x[col_idx_[k]];
+    }
+  }
+  return y;
+}
+
+template <typename Field>
+std::vector<Field> SparseMatrix<Field>::applyTransposed(
+    const std::vector<Field> &x) const {
+  std::vector<Field> y(cols_, Field(0));
+  for (size_t row = 0; row < rows_; ++row) {
+    if (x[row] == Field(0)) {
+      continue;
+    }
+    for (size_t k = row_start_[row]; k < row_start_[row + 1]; ++k) {
+      y[col_idx_[k]] += values_[k] * x[row];
+    }
+  }
+  return y;
+}
+
+template <typename Field>
+std::vector<Field> operator*(const SparseMatrix<Field> &a,
+                             const std::vector<Field> &x) {
+  return a.apply(x);
+}
+
+// Gustavson's row-by-row product with a dense accumulator for the current
+// row of the result.
+template <typename Field>
+SparseMatrix<Field> operator*(const SparseMatrix<Field> &a,
+                              const SparseMatrix<Field> &b) {
+  if (a.cols_ != b.rows_) {
+    throw std::invalid_argument("SparseMatrix: shape mismatch in operator*");
+  }
+  SparseMatrix<Field> res(a.rows_, b.cols_);
+  std::vector<Field> acc(b.cols_, Field(0));
+  std::vector<size_t> last_row(b.cols_, a.rows_);
+  std::vector<size_t> touched;
+  for (size_t row = 0; row < a.rows_; ++row) {
+    touched.clear();
+    for (size_t ka = a.row_start_[row]; ka < a.row_start_[row + 1]; ++ka) {
+      size_t mid = a.col_idx_[ka];
+      for (size_t kb = b.row_start_[mid]; kb < b.row_start_[mid + 1]; ++kb) {
+        size_t col = b.col_idx_[kb];
+        if (last_row[col] != row) {
+          last_row[col] = row;
+          acc[col] = Field(0);
+          touched.push_back(col);
+        }
+        acc[col] += a.values_[ka] * b.values_[kb];
+      }
+    }
+    std::sort(touched.begin(), touched.end());
+    for (size_t col : touched) {
+      if (acc[col] != Field(0)) {
+        res.col_idx_.push_back(col);
+        res.values_.push_back(acc[col]);
+      }
+    }
+    res.row_start_[row + 1] = res.values_.size();
+  }
+  return res;
+}
+
+// res = a * b for a sparse a and a dense b.
+template <size_t M, size_t N, size_t K, typename Field>
+void multiply_into(const SparseMatrix<Field> &a, const Matrix<N, K, Field> &b,
+                   Matrix<M, K, Field> &res) {
+  if (a.rows_ != M || a.cols_ != N) {
+    throw std::invalid_argument("SparseMatrix: shape mismatch in multiply");
+  }
+  for (size_t row = 0; row < M; ++row) {
+    for (size_t k = 0; k < K; ++k) {
+      res[row][k] = Field(0);
+    }
+    for (size_t ka = a.row_start_[row]; ka < a.row_start_[row + 1]; ++ka) {
+      for (size_t k = 0; k < K; ++k) {
+        res[row][k] += a.values_[ka] * b[a.col_idx_[ka]][k];
+      }
+    }
+  }
+}
+
+/*
+================================================================================
+
+                                  WIEDEMANN
+
+================================================================================
+*/
+
+// Black-box det() and rank() of a SparseMatrix over Residue<P>: only
+// matrix-vector products are used, O(n * nonZeros) in total. Both are Monte
+// Carlo methods driven by random projections and diagonal preconditioners;
+// a small P makes an unlucky draw more likely, which attempts compensates.
+
+// Connection polynomial C of the shortest linear recurrence of seq:
+// sum C[j] * seq[i - j] = 0 for i >= L, C[0] = 1, C.size() == L + 1.
+template <size_t P>
+std::vector<Residue<P>> berlekamp_massey(const std::vector<Residue<P>> &seq) {
+  std::vector<Residue<P>> conn(1, Residue<P>(1));
+  std::vector<Residue<P>> prev(1, Residue<P>(1));
+  size_t len = 0;
+  size_t shift = 1;
+  Residue<P> prev_disc(1);
+  for (size_t i = 0; i < seq.size(); ++i) {
+    Residue<P> disc = seq[i];
+    for (size_t j = 1; j <= len; ++j) {
+      disc += conn[j] * seq[i - j];
+    }
+    if (disc == Residue<P>(0)) {
+      ++shift;
+      continue;
+    }
+    Residue<P> coef = disc * inverse(prev_disc);
+    std::vector<Residue<P>> saved = conn;
+    if (conn.size() < prev.size() + shift) {
+      conn.resize(prev.size() + shift, Residue<P>(0));
+    }
+    for (size_t j = 0; j < prev.size(); ++j) {
+      conn[j + shift] -= coef * prev[j];
+    }
+    if (2 * len <= i) {
+      len = i + 1 - len;
+      prev = saved;
+      prev_disc = disc;
+      shift = 1;
+    } else {
+      ++shift;
+    }
+  }
+  conn.resize(len + 1, Residue<P>(0));
+  return conn;
+}
+
+template <size_t P>
+Residue<P> random_residue(std::mt19937_64 &rng, bool nonzero) {
+  Residue<P> r;
+  r.val_ = nonzero ? 1 + rng() % (P - 1) : rng() % P;
+  return r;
+}
+
+// Minimal polynomial (as a connection polynomial) of u^T B^i v for random u,
+// v, where apply computes B x.
+template <size_t P, typename Apply>
+std::vector<Residue<P>> projected_minpoly(size_t n, const Apply &apply,
+                                          std::mt19937_64 &rng) {
+  std::vector<Residue<P>> u(n), v(n);
+  for (size_t i = 0; i < n; ++i) {
+    u[i] = random_residue<P>(rng, false);
+    v[i] = random_residue<P>(rng, false);
+  }
+  std::vector<Residue<P>> seq(2 * n);
+  for (size_t i = 0; i < 2 * n; ++i) {
+    Residue<P> dot(0);
+    for (size_t j = 0; j < n; ++j) {
+      dot += u[j] * v[j];
+    }
+    seq[i] = dot;
+    v = apply(v);
+  }
+  return berlekamp_massey(seq);
+}
+
+// det(A) from the minimal polynomial of A D for a random diagonal D: once
+// it has degree n it is the characteristic polynomial, whose constant term
+// is (-1)^n det(A D). A zero constant term proves A singular.
+template <size_t P>
+Residue<P> wiedemann_det(const SparseMatrix<Residue<P>> &a,
+                         size_t attempts = 4, uint64_t seed = 5489) {
+  size_t n = a.rows();
+  if (n != a.cols()) {
+    throw std::invalid_argument("wiedemann_det: matrix is not square");
+  }
+  std::mt19937_64 rng(seed);
+  for (size_t attempt = 0; attempt < attempts; ++attempt) {
+    std::vector<Residue<P>> diag(n);
+    Residue<P> diag_det(1);
+    for (size_t i = 0; i < n; ++i) {
+      diag[i] = random_residue<P>(rng, true);
+      diag_det *= diag[i];
+    }
+    std::vector<Residue<P>> conn = projected_minpoly<P>(
+        n,
+        [&](std::vector<Residue<P>> x) {
+          for (size_t i = 0; i < n; ++i) {
+            x[i] *= diag[i];
+          }
+          return a.apply(x);
+        },
+        rng);
+    size_t len = conn.size() - 1;
+    if (len > 0 && conn[len] == Residue<P>(0)) {
+      return Residue<P>(0);
+    }
+    if (len == n) {
+      Residue<P> det = conn[n] * inverse(diag_det);
+      return (n % 2 == 0) ? det : Residue<P>(0) - det;
+    }
+  }
+  throw std::runtime_error("wiedemann_det: no certificate, retry with more "
+                           "attempts");
+}
+
+// rank(A) from the minimal polynomial of D1 A^T D2 A D1 for random
+// diagonal D1, D2: its degree is rank(A) + 1 when x divides it and
+// rank(A) otherwise. The largest value over attempts is returned.
+template <size_t P>
+size_t wiedemann_rank(const SparseMatrix<Residue<P>> &a, size_t attempts = 3,
+                      uint64_t seed = 5489) {
+  size_t n = a.cols();
+  std::mt19937_64 rng(seed);
+  size_t rank = 0;
+  for (size_t attempt = 0; attempt < attempts && rank < n; ++attempt) {
+    std::vector<Residue<P>> d1(n), d2(a.rows());
+    for (auto &d : d1) {
+      d = random_residue<P>(rng, true);
+    }
+    for (auto &d : d2) {
+      d = random_residue<P>(rng, true);
+    }
+    std::vector<Residue<P>> conn = projected_minpoly<P>(
+        n,
+        [&](std::vector<Residue<P>> x) {
+          for (size_t i = 0; i < n; ++i) {
+            x[i] *= d1[i];
+          }
+          std::vector<Residue<P>> y = a.apply(x);
+          for (size_t i = 0; i < y.size(); ++i) {
+            y[i] *= d2[i];
+          }
+          x = a.applyTransposed(y);
+          for (size_t i = 0; i < n; ++i) {
+            x[i] *= d1[i];
+          }
+          return x;
+        },
+        rng);
+    size_t len = conn.size() - 1;
+    if (len > 0 && conn[len] == Residue<P>(0)) {
+      --len;
+    }
+    rank = std::max(rank, len);
+  }
+  return rank;
+}
+
+/*
+================================================================================
+
+                                MULTI-MODULAR
+
+================================================================================
+*/
+
+// Exact det() and linear solve over the integers: the matrix is reduced
+// modulo word-sized primes, eliminated with Residue arithmetic, and the
+// result is lifted back with the Chinese remainder theorem. The number of
+// primes is chosen from the Hadamard bound of the input.
+
+// Largest K primes below 2^31.
+template <size_t K>
+constexpr std::array<size_t, K> make_crt_primes() {
+  std::array<size_t, K> primes{};
+  size_t candidate = (size_t(1) << 31) - 1;
+  for (size_t i = 0; i < K; candidate -= 2) {
+    if (miller_rabin(candidate)) {
+      primes[i++] = candidate;
+    }
+  }
+  return primes;
+}
+
+const size_t crt_primes_count = 128;
+
+constexpr std::array<size_t, crt_primes_count> crt_primes =
+    make_crt_primes<crt_primes_count>();
+
+template <size_t P>
+Residue<P> to_residue(const BigInteger &bi) {
+  Residue<P> res;
+  res.val_ = bi.abs().mod(P);
+  return (bi < 0) ? Residue<P>(0) - res : res;
+}
+
+// Elimination of the row-major n x k matrix [A | b] modulo P (Gauss-Jordan
+// when b is present). Returns det(A) * x in the first n entries and det(A) in
+// the last one; all zeros if A is singular modulo P. Shapes are runtime so
+// that only one instantiation per prime is needed.
+template <size_t P>
+std::vector<size_t> modular_solve(const std::vector<BigInteger> &aug, size_t n,
+                                  size_t k) {
+  std::vector<Residue<P>> tmp(n * k);
+  for (size_t i = 0; i < n * k; ++i) {
+    tmp[i] = to_residue<P>(aug[i]);
+  }
+  std::vector<size_t> res(n + 1, 0);
+  Residue<P> det(1);
+  for (size_t col = 0; col < n; ++col) {
+    size_t pivot = col;
+    while (pivot < n && tmp[pivot * k + col] == Residue<P>(0)) {
+      ++pivot;
+    }
+    if (pivot == n) {
+      return res;
+    }
+    Residue<P> *pivot_row = &tmp[col * k];
+    if (pivot != col) {
+      det = Residue<P>(0) - det;
+      std::swap_ranges(pivot_row, pivot_row + k, &tmp[pivot * k]);
+    }
+    det *= pivot_row[col];
+    Residue<P> inv = inverse(pivot_row[col]);
+    for (size_t i = col; i < k; ++i) {
+      pivot_row[i] *= inv;
+    }
+    for (size_t row = (k > n) ? 0 : col + 1; row < n; ++row) {
+      Residue<P> *cur_row = &tmp[row * k];
+      if (row == col || cur_row[col] == Residue<P>(0)) {
+        continue;
+      }
+      Residue<P> num = cur_row[col];
+      subtract_scaled_row(cur_row + col, pivot_row + col, num, k - col);
+    }
+  }
+  for (size_t i = 0; k > n && i < n; ++i) {
+    res[i] = (det * tmp[i * k + n]).val_;
+  }
+  res[n] = det.val_;
+  return res;
+}
+
+using ModularSolver = std::vector<size_t> (*)(const std::vector<BigInteger> &,
+                                              size_t, size_t);
+
+template <size_t... I>
+constexpr std::array<ModularSolver, sizeof...(I)> make_modular_solvers(
+    std::index_sequence<I...>) {
+  return {&modular_solve<crt_primes[I]>...};
+}
+
+template <typename Task>
+void for_each_prime(size_t first, size_t last, bool parallel, Task task) {
+  size_t n_workers = std::min<size_t>(std::thread::hardware_concurrency(),
+                                      last - first);
+  if (!parallel || n_workers <= 1) {
+    for (size_t i = first; i < last; ++i) {
+      task(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next(first);
+  std::vector<std::thread> workers;
+  for (size_t w = 0; w < n_workers; ++w) {
+    workers.emplace_back([&]() {
+      for (size_t i = next++; i < last; i = next++) {
+        task(i);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// Incremental Garner reconstruction; value stays in [0, modulus).
+class CrtAccumulator {
+ public:
+  CrtAccumulator() : value_(0), modulus_(1) {}
+
+  void add(size_t residue, size_t prime) {
+    uint64_t shift = (residue + prime - value_.mod(prime)) % prime;
+    uint64_t scale = modulus_.mod(prime);
+    int64_t x = 0, y = 0;
+    gcd_ext(scale, prime, x, y);
+    x %= static_cast<int64_t>(prime);
+    shift = shift * ((x < 0) ? x + prime : x) % prime;
+    value_ += modulus_.times(shift);
+    modulus_ = modulus_.times(prime);
+  }
+
+  BigInteger symmetric() const {
+    if (value_ + value_ > modulus_) {
+      return -BigInteger(modulus_ - value_);
+    }
+    return BigInteger(value_);
+  }
+
+  double log2_modulus() const { return modulus_.log2(); }
+
+ private:
+  UnsignedBigInteger value_;
+  UnsignedBigInteger modulus_;
+};
+
+// log2 of the Euclidean norm of column col, clamped below at 0.
+template <size_t N, size_t K>
+double log2_column_norm(const Matrix<N, K, BigInteger> &m, size_t col) {
+  std::array<double, N> logs;
+  double top = 0;
+  for (size_t i = 0; i < N; ++i) {
+    logs[i] = (m[i][col] == 0) ? -1 : m[i][col].abs().log2();
+    top = std::max(top, logs[i]);
+  }
+  double sum = 0;
+  for (size_t i = 0; i < N; ++i) {
+    if (logs[i] >= 0) {
+      sum += std::exp2(2 * (logs[i] - top));
+    }
+  }
+  return std::max(0.0, top + 0.5 * std::log2(sum));
+}
+
+// Lifts det(A) and det(A) * x for the augmented [A | b], skipping primes
+// that divide det(A) when b is present.
+template <size_t N, size_t K>
+std::array<BigInteger, N + 1> multimodular_lift(
+    const Matrix<N, K, BigInteger> &aug, bool parallel) {
+  double bound = 0;
+  double min_norm = 0;
+  for (size_t j = 0; j < K; ++j) {
+    double norm = log2_column_norm(aug, j);
+    bound += norm;
+    min_norm = (j == 0) ? norm : std::min(min_norm, norm);
+  }
+  if (K > N) {
+    bound -= min_norm;
+  }
+  double needed_bits = bound + 2;
+  double unlucky_bits = 0;
+
+  static const std::array<ModularSolver, crt_primes_count> solvers =
+      make_modular_solvers(std::make_index_sequence<crt_primes_count>());
+  std::vector<BigInteger> flat;
+  flat.reserve(N * K);
+  for (size_t i = 0; i < N; ++i) {
+    flat.insert(flat.end(), aug[i].begin(), aug[i].end());
+  }
+  std::vector<std::vector<size_t>> images(crt_primes_count);
+  std::array<CrtAccumulator, N + 1> acc;
+  size_t next = 0;
+  while (acc[N].log2_modulus() < needed_bits) {
+    double missing = needed_bits - acc[N].log2_modulus();
+    size_t batch = static_cast<size_t>(missing / 30) + 1;
+    if (next + batch > crt_primes_count) {
+      throw std::overflow_error("multimodular: Hadamard bound exceeds primes");
+    }
+    for_each_prime(next, next + batch, parallel, [&](size_t idx) {
+      images[idx] = solvers[idx](flat, N, K);
+    });
+    for (; batch > 0; --batch, ++next) {
+      if (K > N && images[next][N] == 0) {
+        unlucky_bits += std::log2(static_cast<double>(crt_primes[next]));
+        continue;
+      }
+      for (size_t i = 0; i <= N; ++i) {
+        acc[i].add(images[next][i], crt_primes[next]);
+      }
+    }
+    if (unlucky_bits >= needed_bits) {
+      throw std::invalid_argument("multimodular: matrix is singular");
+    }
+  }
+  std::array<BigInteger, N + 1> res;
+  for (size_t i = 0; i <= N; ++i) {
+    res[i] = acc[i].symmetric();
+  }
+  return res;
+}
+
+template <size_t N>
+BigInteger multimodular_det(const Matrix<N, N, BigInteger> &m,
+                            bool parallel = false) {
+  return multimodular_lift(m, parallel)[N];
+}
+
+template <size_t N>
+Rational multimodular_det(const Matrix<N, N, Rational> &m,
+                          bool parallel = false) {
+  BigInteger scale(1);
+  Matrix<N, N, BigInteger> integral = clear_denominators(m, scale);
+  return Rational(multimodular_det(integral, parallel)) / Rational(scale);
+}
+
+// Solution of a * x = b. The CRT lifts det(a) * x, whose entries are the
+// Cramer numerators, so the rational solution is recovered by a single
+// division per entry.
+template <size_t N>
+std::array<Rational, N> multimodular_solve(const Matrix<N, N, Rational> &a,
+                                           const std::array<Rational, N> &b,
+                                           bool parallel = false) {
+  Matrix<N, N + 1, Rational> aug;
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      aug[i][j] = a[i][j];
+    }
+    aug[i][N] = b[i];
+  }
+  BigInteger scale(1);
+  std::array<BigInteger, N + 1> lifted =
+      multimodular_lift(clear_denominators(aug, scale), parallel);
+  if (lifted[N] == 0) {
+    throw std::invalid_argument("multimodular: matrix is singular");
+  }
+  std::array<Rational, N> x;
+  for (size_t i = 0; i < N; ++i) {
+    x[i] = Rational(lifted[i]) / Rational(lifted[N]);
+  }
+  return x;
+}
+
+/*
+================================================================================
+
+                                 POLYNOMIALS
+
+================================================================================
+*/
+
+// Products use the number-theoretic transform when the field is
+// Residue<P> with 2^k | P - 1 for a large enough k, Karatsuba above
+// poly_karatsuba_cutoff coefficients otherwise, and the schoolbook method
+// below it.
+const size_t poly_karatsuba_cutoff = 32;
+const size_t poly_ntt_cutoff = 64;
+
+constexpr size_t two_adicity(size_t n) {
+  size_t k = 0;
+  for (; n > 0 && n % 2 == 0; n /= 2) {
+    ++k;
+  }
+  return k;
+}
+
+// log2 of the longest transform supported by the field, 0 if none.
+template <typename Field>
+const size_t ntt_max_log = 0;
+
+template <size_t P>
+const size_t ntt_max_log<Residue<P>> =
+    is_prime_modulus<P> ? two_adicity(P - 1) : 0;
+
+template <size_t P>
+void ntt(std::vector<Residue<P>> &a, bool invert) {
+  size_t n = a.size();
+  for (size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(a[i], a[j]);
+    }
+  }
+  std::vector<Residue<P>> roots(n / 2);
+  for (size_t len = 2; len <= n; len <<= 1) {
+    Residue<P> root;
+    root.val_ = pow_mod(primitive_root<P>, (P - 1) / len, P);
+    if (invert) {
+      root = inverse(root);
+    }
+    size_t half = len / 2;
+    roots[0] = Residue<P>(1);
+    for (size_t j = 1; j < half; ++j) {
+      roots[j] = roots[j - 1] * root;
+    }
+    for (size_t i = 0; i < n; i += len) {
+      for (size_t j = 0; j < half; ++j) {
+        Residue<P> u = a[i + j];
+        Residue<P> v = a[i + j + half] * roots[j];
+        a[i + j] = u + v;
+        a[i + j + half] = u - v;
+      }
+    }
+  }
+  if (invert) {
+    Residue<P> n_inv = inverse(Residue<P>(static_cast<int>(n)));
+    for (Residue<P> &x : a) {
+      x *= n_inv;
+    }
+  }
+}
+
+template <typename Field>
+std::vector<Field> schoolbook_multiply(const Field *a, size_t a_size,
+                                       const Field *b, size_t b_size) {
+  std::vector<Field> res(a_size + b_size - 1, Field(0));
+  for (size_t i = 0; i < a_size; ++i) {
+    if (a[i] == Field(0)) {
+      continue;
+    }
+    for (size_t j = 0; j < b_size; ++j) {
+      res[i + j] += a[i] * b[j];
+    }
+  }
+  return res;
+}
+
+// Product of two length-n blocks, 2n - 1 coefficients.
+template <typename Field>
+std::vector<Field> karatsuba_multiply(const Field *a, const Field *b,
+                                      size_t n) {
+  if (n <= poly_karatsuba_cutoff) {
+    return schoolbook_multiply(a, n, b, n);
+  }
+  size_t half = n / 2;
+  size_t rest = n - half;
+  std::vector<Field> low = karatsuba_multiply(a, b, half);
+  std::vector<Field> high = karatsuba_multiply(a + half, b + half, rest);
+  std::vector<Field> a_sum(a + half, a + n);
+  std::vector<Field> b_sum(b + half, b + n);
+  for (size_t i = 0; i < half; ++i) {
+    a_sum[i] += a[i];
+    b_sum[i] += b[i];
+  }
+  std::vector<Field> mid = karatsuba_multiply(a_sum.data(), b_sum.data(), rest);
+  for (size_t i = 0; i < low.size(); ++i) {
+    mid[i] -= low[i];
+  }
+  for (size_t i = 0; i < high.size(); ++i) {
+    mid[i] -= high[i];
+  }
+  std::vector<Field> res(2 * n - 1, Field(0));
+  for (size_t i = 0; i < low.size(); ++i) {
+    res[i] += low[i];
+  }
+  for (size_t i = 0; i < mid.size(); ++i) {
+    res[i + half] += mid[i];
+  }
+  for (size_t i = 0; i < high.size(); ++i) {
+    res[i + 2 * half] += high[i];
+  }
+  return res;
+}
+
+template <typename Field>
+std::vector<Field> convolve(const std::vector<Field> &a,
+                            const std::vector<Field> &b) {
+  if (a.empty() || b.empty()) {
+    return {};
+  }
+  size_t res_size = a.size() + b.size() - 1;
+  if constexpr (ntt_max_log<Field> > 0) {
+    size_t n = 1;
+    while (n < res_size) {
+      n <<= 1;
+    }
+    if (std::min(a.size(), b.size()) > poly_ntt_cutoff &&
+        n <= (size_t(1) << ntt_max_log<Field>)) {
+      std::vector<Field> fa(a);
+      std::vector<Field> fb(b);
+      fa.resize(n, Field(0));
+      fb.resize(n, Field(0));
+      ntt(fa, false);
+      ntt(fb, false);
+      for (size_t i = 0; i < n; ++i) {
+        fa[i] *= fb[i];
+      }
+      ntt(fa, true);
+      fa.resize(res_size);
+      return fa;
+    }
+  }
+  const std::vector<Field> &longer = (a.size() >= b.size()) ? a : b;
+  const std::vector<Field> &shorter = (a.size() >= b.size()) ? b : a;
+  size_t m = shorter.size();
+  if (m <= poly_karatsuba_cutoff) {
+    return schoolbook_multiply(longer.data(), longer.size(), shorter.data(), m);
+  }
+  // The longer operand is cut into blocks of the shorter one's length.
+  std::vector<Field> res(res_size, Field(0));
+  std::vector<Field> block(m, Field(0));
+  for (size_t start = 0; start < longer.size(); start += m) {
+    size_t len = std::min(m, longer.size() - start);
+    std::fill(block.begin(), block.end(), Field(0));
+    std::copy(longer.begin() + start, longer.begin() + start + len,
+              block.begin());
+    std::vector<Field> part =
+        karatsuba_multiply(block.data(), shorter.data(), m);
+    for (size_t i = 0; i < part.size() && start + i < res_size; ++i) {
+      res[start + i] += part[i];
+    }
+  }
+  return res;
+}
+
+// Coefficients are stored lowest degree first with no trailing zeros, so
+// the zero polynomial is empty and has degree -1.
+template <typename Field>
+class Polynomial {
+ public:
+  Polynomial() = default;
+  Polynomial(const Field &c);
+  Polynomial(std::vector<Field> coeffs);
+  Polynomial(const std::initializer_list<Field> &coeffs);
+
+  int degree() const;
+  size_t size() const;
+  Field operator[](size_t idx) const;
+  const std::vector<Field> &coefficients() const;
+  Field operator()(const Field &x) const;
+
+  Polynomial<Field> &operator+=(const Polynomial<Field> &p);
+  Polynomial<Field> &operator-=(const Polynomial<Field> &p);
+  Polynomial<Field> &operator*=(const Polynomial<Field> &p);
+  Polynomial<Field> &operator/=(const Polynomial<Field> &p);
+  Polynomial<Field> &operator%=(const Polynomial<Field> &p);
+
+  Polynomial<Field> truncated(size_t n) const;
+  Polynomial<Field> reversed(size_t n) const;
+  Polynomial<Field> inverse(size_t n) const;
+  std::vector<Field> evaluate(const std::vector<Field> &points) const;
+
+ private:
+  void trim();
+
+  std::vector<Field> coeffs_;
+};
+
+template <typename Field>
+Polynomial<Field>::Polynomial(const Field &c) : coeffs_(1, c) {
+  trim();
+}
+
+template <typename Field>
+Polynomial<Field>::Polynomial(std::vector<Field> coeffs)
+    : coeffs_(std::move(coeffs)) {
+  trim();
+}
+
+template <typename Field>
+Polynomial<Field>::Polynomial(const std::initializer_list<Field> &coeffs)
+    : coeffs_(coeffs) {
+  trim();
+}
+
+template <typename Field>
+void Polynomial<Field>::trim() {
+  while (!coeffs_.empty() && coeffs_.back() == Field(0)) {
+    coeffs_.pop_back();
+  }
+}
+
+template <typename Field>
+int Polynomial<Field>::degree() const {
+  return static_cast<int>(coeffs_.size()) - 1;
+}
+
+template <typename Field>
+size_t Polynomial<Field>::size() const {
+  return coeffs_.size();
+}
+
+template <typename Field>
+Field Polynomial<Field>::operator[](size_t idx) const {
+  return (idx < coeffs_.size()) ? coeffs_[idx] : Field(0);
+}
+
+template <typename Field>
+const std::vector<Field> &Polynomial<Field>::coefficients() const {
+  return coeffs_;
+}
+
+template <typename Field>
+Field Polynomial<Field>::operator()(const Field &x) const {
+  Field res(0);
+  for (size_t i = coeffs_.size(); i-- > 0;) {
+    res = res * x + coeffs_[i];
+  }
+  return res;
+}
+
+template <typename Field>
+Polynomial<Field> &Polynomial<Field>::operator+=(const Polynomial<Field> &p) {
+  if (coeffs_.size() < p.coeffs_.size()) {
+    coeffs_.resize(p.coeffs_.size(), Field(0));
+  }
+  for (size_t i = 0; i < p.coeffs_.size(); ++i) {
+    coeffs_[i] = coeffs_[i] + p.coeffs_[i];
+  }
+  trim();
+  return *this;
+}
+
+template <typename Field>
+Polynomial<Field> &Polynomial<Field>::operator-=(const Polynomial<Field> &p) {
+  if (coeffs_.size() < p.coeffs_.size()) {
+    coeffs_.resize(p.coeffs_.size(), Field(0));
+  }
+  for (size_t i = 0; i < p.coeffs_.size(); ++i) {
+    coeffs_[i] = coeffs_[i] - p.coeffs_[i];
+  }
+  trim();
+  return *this;
+}
+
+template <typename Field>
+Polynomial<Field> &Polynomial<Field>::operator*=(const Polynomial<Field> &p) {
+  coeffs_ = convolve(coeffs_, p.coeffs_);
+  trim();
+  return *this;
+}
+
+template <typename Field>
+Polynomial<Field> &Polynomial<Field>::operator/=(const Polynomial<Field> &p) {
+  return *this = divmod(*this, p).first;
+}
+
+template <typename Field>
+Polynomial<Field> &Polynomial<Field>::operator%=(const Polynomial<Field> &p) {
+  return *this = divmod(*this, p).second;
+}
+
+// This modulo x^n.
+template <typename Field>
+Polynomial<Field> Polynomial<Field>::truncated(size_t n) const {
+  return Polynomial<Field>(std::vector<Field>(
+      coeffs_.begin(), coeffs_.begin() + std::min(n, coeffs_.size())));
+}
+
+// x^(n-1) * this(1/x) for a polynomial of fewer than n coefficients.
+template <typename Field>
+Polynomial<Field> Polynomial<Field>::reversed(size_t n) const {
+  std::vector<Field> res(n, Field(0));
+  for (size_t i = 0; i < coeffs_.size() && i < n; ++i) {
+    res[n - 1 - i] = coeffs_[i];
+  }
+  return Polynomial<Field>(std::move(res));
+}
+
+// 1 / this modulo x^n by Newton's iteration g <- g (2 - this * g), which
+// doubles the number of correct coefficients per step.
+template <typename Field>
+Polynomial<Field> Polynomial<Field>::inverse(size_t n) const {
+  if (coeffs_.empty() || coeffs_[0] == Field(0)) {
+    throw std::invalid_argument("Polynomial::inverse: constant term is zero");
+  }
+  Polynomial<Field> res(Field(1) / coeffs_[0]);
+  for (size_t len = 1; len < n;) {
+    len *= 2;
+    Polynomial<Field> correction = (truncated(len) * res).truncated(len);
+    correction = Polynomial<Field>(Field(2)) - correction;
+    res = (res * correction).truncated(len);
+  }
+  return res.truncated(n);
+}
+
+// Quotient and remainder. Long division is used for short divisors or
+// quotients; otherwise the reversed quotient is found as a power series
+// product with the inverse of the reversed divisor.
+template <typename Field>
+std::pair<Polynomial<Field>, Polynomial<Field>> divmod(
+    const Polynomial<Field> &a, const Polynomial<Field> &b) {
+  if (b.size() == 0) {
+    throw std::invalid_argument("Polynomial: division by zero");
+  }
+  if (a.degree() < b.degree()) {
+    return {Polynomial<Field>(), a};
+  }
+  size_t q_size = a.size() - b.size() + 1;
+  if (std::min(q_size, b.size()) <= poly_karatsuba_cutoff) {
+    std::vector<Field> rem = a.coefficients();
+    std::vector<Field> quot(q_size, Field(0));
+    Field lead_inv = Field(1) / b.coefficients().back();
+    for (size_t i = q_size; i-- > 0;) {
+      Field c = rem[i + b.size() - 1] * lead_inv;
+      quot[i] = c;
+      if (c == Field(0)) {
+        continue;
+      }
+      subtract_scaled_row(rem.data() + i, b.coefficients().data(), c,
+                          b.size());
+    }
+    rem.resize(b.size() - 1);
+    return {Polynomial<Field>(std::move(quot)),
+            Polynomial<Field>(std::move(rem))};
+  }
+  Polynomial<Field> rev_q = (a.reversed(a.size()).truncated(q_size) *
+                             b.reversed(b.size()).inverse(q_size))
+                                .truncated(q_size);
+  Polynomial<Field> q = rev_q.reversed(q_size);
+  Polynomial<Field> r = a - b * q;
+  return {q, r};
+}
+
+// Values at every point through the subproduct tree: the remainder modulo
+// the product of (x - p) over a segment is passed down to both halves.
+template <typename Field>
+std::vector<Field> Polynomial<Field>::evaluate(
+    const std::vector<Field> &points) const {
+  size_t n = points.size();
+  std::vector<Field> res(n);
+  if (n <= poly_karatsuba_cutoff) {
+    for (size_t i = 0; i < n; ++i) {
+      res[i] = (*this)(points[i]);
+    }
+    return res;
+  }
+  std::vector<Polynomial<Field>> tree(4 * n);
+  auto build = [&](auto &&self, size_t node, size_t lo, size_t hi) -> void {
+    if (hi - lo == 1) {
+      tree[node] = Polynomial<Field>({Field(0) - points[lo], Field(1)});
+      return;
+    }
+    size_t mid = (lo + hi) / 2;
+    self(self, 2 * node, lo, mid);
+    self(self, 2 * node + 1, mid, hi);
+    tree[node] = tree[2 * node] * tree[2 * node + 1];
+  };
+  auto descend = [&](auto &&self, size_t node, size_t lo, size_t hi,
+                     const Polynomial<Field> &p) -> void {
+    if (hi - lo <= poly_karatsuba_cutoff) {
+      for (size_t i = lo; i < hi; ++i) {
+        res[i] = p(points[i]);
+      }
+      return;
+    }
+    size_t mid = (lo + hi) / 2;
+    self(self, 2 * node, lo, mid, p % tree[2 * node]);
+    self(self, 2 * node + 1, mid, hi, p % tree[2 * node + 1]);
+  };
+  build(build, 1, 0, n);
+  descend(descend, 1, 0, n, *this % tree[1]);
+  return res;
+}
+
+template <typename Field>
+Polynomial<Field> operator+(Polynomial<Field> a, const Polynomial<Field> &b) {
+  return a += b;
+}
+template <typename Field>
+Polynomial<Field> operator-(Polynomial<Field> a, const Polynomial<Field> &b) {
+  return a -= b;
+}
+template <typename Field>
+Polynomial<Field> operator*(Polynomial<Field> a, const Polynomial<Field> &b) {
+  return a *= b;
+}
+template <typename Field>
+Polynomial<Field> operator/(const Polynomial<Field> &a,
+                            const Polynomial<Field> &b) {
+  return divmod(a, b).first;
+}
+template <typename Field>
+Polynomial<Field> operator%(const Polynomial<Field> &a,
+                            const Polynomial<Field> &b) {
+  return divmod(a, b).second;
+}
+
+template <typename Field>
+bool operator==(const Polynomial<Field> &a, const Polynomial<Field> &b) {
+  return a.coefficients() == b.coefficients();
+}
+
+template <typename Field>
+bool operator!=(const Polynomial<Field> &a, const Polynomial<Field> &b) {
+  return !(a == b);
+}
+
+/*
+================================================================================
+
+                                 MATRIX I/O
+
+================================================================================
+*/
+
+// Bulk loading: the whole file is read into one buffer and entries are
+// parsed in place from [first, last) token ranges, with no per-token
+// strings. BigInteger and Rational entries still allocate their chunks,
+// through a temporary that is then copied in; Residue and double entries
+// allocate nothing. The text format is the one operator>> reads: M * N
+// whitespace-separated entries in row-major order, rationals as p or p/q.
+// The binary format is a native-endian checkpoint: a header with the shape
+// and field, then the entries.
+
+std::string read_file(const std::string &path) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) {
+    throw std::runtime_error("cannot open " + path);
+  }
+  std::string buf(static_cast<size_t>(in.tellg()), '\0');
+  in.seekg(0);
+  if (!in.read(buf.data(), static_cast<std::streamsize>(buf.size()))) {
+    throw std::runtime_error("cannot read " + path);
+  }
+  return buf;
+}
+
+void write_file(const std::string &path, const std::string &buf) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out.write(buf.data(), static_cast<std::streamsize>(buf.size()))) {
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+void parse_entry(const char *first, const char *last, BigInteger &bi) {
+  bi = BigInteger(first, last);
+}
+
+void parse_entry(const char *first, const char *last, Rational &r) {
+  const char *slash = static_cast<const char *>(
+      std::memchr(first, '/', static_cast<size_t>(last - first)));
+  if (slash == nullptr) {
+    r = Rational(BigInteger(first, last));
+  } else {
+    r = Rational(BigInteger(first, slash), BigInteger(slash + 1, last));
+  }
+}
+
+void parse_entry(const char *first, const char *last, double &d) {
+  std::from_chars_result res = std::from_chars(first, last, d);
+  if (res.ec != std::errc() || res.ptr != last) {
+    throw std::invalid_argument("parse_entry: bad floating-point number");
+  }
+}
+
+// Reduced digit by digit, so entries of any length need no big integer.
+template <size_t P>
+void parse_entry(const char *first, const char *last, Residue<P> &r) {
+  bool negative = (first != last && *first == '-');
+  if (first != last && (*first == '-' || *first == '+')) {
+    ++first;
+  }
+  if (first == last) {
+    throw std::invalid_argument("parse_entry: empty number");
+  }
+  size_t val = 0;
+  for (; first != last; ++first) {
+    if (*first < '0' || *first > '9') {
+      throw std::invalid_argument("parse_entry: not a digit");
+    }
+    size_t digit = static_cast<size_t>(*first - '0');
+    if constexpr (P < (size_t(1) << 59)) {
+      val = (val * 10 + digit) % P;
+    } else {
+      val = mul_mod(val, 10, P) + digit;
+      val -= (val >= P) ? P : 0;
+    }
+  }
+  r.val_ = (negative && val != 0) ? P - val : val;
+}
+
+// Fills m from the text in [first, last).
+template <size_t M, size_t N, typename Field>
+void parse_matrix(const char *first, const char *last,
+                  Matrix<M, N, Field> &m) {
+  auto is_space = [](char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+           c == '\f';
+  };
+  for (size_t i = 0; i < M; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      while (first != last && is_space(*first)) {
+        ++first;
+      }
+      const char *token = first;
+      while (first != last && !is_space(*first)) {
+        ++first;
+      }
+      if (token == first) {
+        throw std::invalid_argument("parse_matrix: too few entries");
+      }
+      parse_entry(token, first, m[i][j]);
+    }
+  }
+}
+
+template <size_t M, size_t N, typename Field>
+void load_text(const std::string &path, Matrix<M, N, Field> &m) {
+  std::string buf = read_file(path);
+  parse_matrix(buf.data(), buf.data() + buf.size(), m);
+}
+
+template <typename T>
+void put_raw(std::string &out, const T &val) {
+  out.append(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+template <typename T>
+T get_raw(const char *&cur, const char *end) {
+  if (static_cast<size_t>(end - cur) < sizeof(T)) {
+    throw std::runtime_error("load_binary: truncated file");
+  }
+  T val;
+  std::memcpy(&val, cur, sizeof(T));
+  cur += sizeof(T);
+  return val;
+}
+
+// Field tags of the binary header: kind, then the modulus for residues.
+template <typename Field>
+struct BinaryField;
+
+template <>
+struct BinaryField<BigInteger> {
+  static constexpr uint64_t kind = 1;
+  static constexpr uint64_t modulus = 0;
+};
+
+template <>
+struct BinaryField<Rational> {
+  static constexpr uint64_t kind = 2;
+  static constexpr uint64_t modulus = 0;
+};
+
+template <>
+struct BinaryField<double> {
+  static constexpr uint64_t kind = 3;
+  static constexpr uint64_t modulus = 0;
+};
+
+template <size_t P>
+struct BinaryField<Residue<P>> {
+  static constexpr uint64_t kind = 4;
+  static constexpr uint64_t modulus = P;
+};
+
+// Big integers are a sign byte, a chunk count and the base 10^9 chunks as
+// 32-bit words.
+void write_entry(std::string &out, const BigInteger &bi) {
+  put_raw(out, static_cast<uint8_t>(bi < 0));
+  UnsignedBigInteger ubi = bi.abs();
+  put_raw(out, static_cast<uint32_t>(ubi.chunks().size()));
+  for (uint64_t chunk : ubi.chunks()) {
+    put_raw(out, static_cast<uint32_t>(chunk));
+  }
+}
+
+void read_entry(const char *&cur, const char *end, BigInteger &bi) {
+  bool negative = get_raw<uint8_t>(cur, end) != 0;
+  uint32_t n_chunks = get_raw<uint32_t>(cur, end);
+  // The count comes from the file: check it against the bytes left before
+  // allocating, so a corrupt count cannot ask for gigabytes.
+  if (static_cast<size_t>(end - cur) / sizeof(uint32_t) < n_chunks) {
+    throw std::runtime_error("load_binary: truncated file");
+  }
+  std::vector<uint64_t> chunks(n_chunks);
+  for (uint64_t &chunk : chunks) {
+    chunk = get_raw<uint32_t>(cur, end);
+  }
+  bi = BigInteger(UnsignedBigInteger::from_chunks(std::move(chunks)));
+  if (negative) {
+    bi.Invert();
+  }
+}
+
+void write_entry(std::string &out, const Rational &r) {
+  write_entry(out, r.getNumerator());
+  write_entry(out, r.getDenominator());
+}
+
+// Checkpoints hold reduced fractions, so the gcd pass is skipped.
+void read_entry(const char *&cur, const char *end, Rational &r) {
+  read_entry(cur, end, r.numerator);
+  read_entry(cur, end, r.denominator);
+  if (r.denominator <= 0) {
+    throw std::runtime_error("load_binary: bad denominator");
+  }
+}
+
+void write_entry(std::string &out, double d) { put_raw(out, d); }
+
+void read_entry(const char *&cur, const char *end, double &d) {
+  d = get_raw<double>(cur, end);
+}
+
+template <size_t P>
+void write_entry(std::string &out, const Residue<P> &r) {
+  put_raw(out, static_cast<uint64_t>(r.val_));
+}
+
+template <size_t P>
+void read_entry(const char *&cur, const char *end, Residue<P> &r) {
+  uint64_t val = get_raw<uint64_t>(cur, end);
+  if (val >= P) {
+    throw std::runtime_error("load_binary: residue out of range");
+  }
+  r.val_ = val;
+}
+
+const char matrix_binary_magic[4] = {'M', 'T', 'X', '1'};
+
+template <size_t M, size_t N, typename Field>
+void save_binary(const std::string &path, const Matrix<M, N, Field> &m) {
+  std::string out(matrix_binary_magic, sizeof(matrix_binary_magic));
+  put_raw(out, static_cast<uint64_t>(M));
+  put_raw(out, static_cast<uint64_t>(N));
+  put_raw(out, BinaryField<Field>::kind);
+  put_raw(out, BinaryField<Field>::modulus);
+  for (size_t i = 0; i < M; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      write_entry(out, m[i][j]);
+    }
+  }
+  write_file(path, out);
+}
+
+template <size_t M, size_t N, typename Field>
+void load_binary(const std::string &path, Matrix<M, N, Field> &m) {
+  std::string buf = read_file(path);
+  const char *cur = buf.data();
+  const char *end = buf.data() + buf.size();
+  if (buf.size() < sizeof(matrix_binary_magic) ||
+      std::memcmp(cur, matrix_binary_magic, sizeof(matrix_binary_magic)) !=
+          0) {
+    throw std::runtime_error("load_binary: not a matrix file");
+  }
+  cur += sizeof(matrix_binary_magic);
+  uint64_t rows = get_raw<uint64_t>(cur, end);
+  uint64_t cols = get_raw<uint64_t>(cur, end);
+  uint64_t kind = get_raw<uint64_t>(cur, end);
+  uint64_t modulus = get_raw<uint64_t>(cur, end);
+  if (rows != M || cols != N || kind != BinaryField<Field>::kind ||
+      modulus != BinaryField<Field>::modulus) {
+    throw std::runtime_error("load_binary: shape or field mismatch");
+  }
+  for (size_t i = 0; i < M; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      read_entry(cur, end, m[i][j]);
+    }
+  }
+}